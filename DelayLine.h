@@ -0,0 +1,74 @@
+//
+//  DelayLine.h
+//  MyEffect Delay Line
+//
+//  The lookahead's delay: holds the audio back a whole number of samples, so the detector sees
+//  transients before they reach the gain. A circular buffer with a power-of-two capacity, so
+//  positions wrap with a mask instead of branches. Audio moves in whole blocks: process() writes
+//  the block and reads it back delayed, each in at most two memcpy() segments, so any delay from
+//  0 up works with any block length up to the one given to setMaxDelay(). A new delay is jumped
+//  to (the gate changes its latency with it). The echo, with its fractional, gliding taps, is
+//  MultiTapDelay.h.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class DelayLine
+{
+public:
+    DelayLine() : uMask(0), uWrite(0), iMaxDelay(0), iDelay(0) { setMaxDelay(0, 1); }
+
+    // sizes the buffer for delays up to iMaxDelaySamples and blocks up to iMaxBlockSize samples
+    // (allocates and clears: not for the audio thread)
+    void setMaxDelay(int iMaxDelaySamples, int iMaxBlockSize)
+    {
+        iMaxDelay = iMaxDelaySamples < 0 ? 0 : iMaxDelaySamples;
+        int iMaxBlock = iMaxBlockSize < 1 ? 1 : iMaxBlockSize;
+        uint32_t uCapacity = 1;
+        while (uCapacity < (uint32_t)(iMaxDelay + iMaxBlock))
+            uCapacity <<= 1;
+        buffer.assign(uCapacity, 0.f);
+        uMask = uCapacity - 1;
+        if (iDelay > iMaxDelay)
+            iDelay = iMaxDelay;
+        uWrite = 0;
+    }
+    int getMaxDelay() const { return iMaxDelay; }
+
+    // sets the delay in samples (clamped to 0..getMaxDelay())
+    void setDelay(int iSamples) { iDelay = iSamples < 0 ? 0 : (iSamples > iMaxDelay ? iMaxDelay : iSamples); }
+    int getDelay() const { return iDelay; }
+
+    // silences the line (the delay is kept)
+    void reset()
+    {
+        memset(buffer.data(), 0, buffer.size() * sizeof(float));
+        uWrite = 0;
+    }
+
+    // pfOut is pfIn delayed by the current delay (pfOut may be pfIn)
+    void process(const float *pfIn, float *pfOut, int iCount)
+    {
+        //writes the block in
+        uint32_t uAt = uWrite & uMask;
+        uint32_t uFirst = (uint32_t)iCount < uMask + 1 - uAt ? (uint32_t)iCount : uMask + 1 - uAt;
+        memcpy(&buffer[uAt], pfIn, uFirst * sizeof(float));
+        memcpy(&buffer[0], pfIn + uFirst, (iCount - uFirst) * sizeof(float));
+
+        //and reads it back from iDelay samples earlier
+        uAt = (uWrite - iDelay) & uMask;
+        uFirst = (uint32_t)iCount < uMask + 1 - uAt ? (uint32_t)iCount : uMask + 1 - uAt;
+        memcpy(pfOut, &buffer[uAt], uFirst * sizeof(float));
+        memcpy(pfOut + uFirst, &buffer[0], (iCount - uFirst) * sizeof(float));
+        uWrite += iCount;
+    }
+
+private:
+    std::vector<float> buffer;
+    uint32_t uMask, uWrite;    // uWrite counts samples written (wraps harmlessly)
+    int iMaxDelay, iDelay;
+};
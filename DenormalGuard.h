@@ -0,0 +1,50 @@
+//
+//  DenormalGuard.h
+//  MyEffect Denormal Guard
+//
+//  Turns on flush-to-zero and denormals-are-zero for as long as it is in scope, and puts the
+//  previous mode back when it goes. Denormals (floats below about 1e-38) turn up wherever a
+//  signal decays away - filter state, feedback tails, release envelopes - and every operation
+//  on one can cost a hundred times a normal one. One at the top of process() covers the whole
+//  block without changing the mode the host runs its own code in.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+class DenormalGuard
+{
+public:
+    DenormalGuard()
+    {
+#if defined(__SSE__) || defined(_M_X64)
+        uOldMode = _mm_getcsr();
+        _mm_setcsr(uOldMode | 0x8040); // MXCSR: FTZ (bit 15) and DAZ (bit 6)
+#elif defined(__aarch64__)
+        uint64_t uMode;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(uMode));
+        uOldMode = uMode;
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(uMode | (1 << 24))); // FPCR: FZ
+#endif
+    }
+
+    ~DenormalGuard()
+    {
+#if defined(__SSE__) || defined(_M_X64)
+        _mm_setcsr((unsigned int)uOldMode);
+#elif defined(__aarch64__)
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(uOldMode));
+#endif
+    }
+
+    DenormalGuard(const DenormalGuard&) = delete;
+    DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+private:
+    uint64_t uOldMode;
+};
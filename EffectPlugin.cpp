@@ -47,12 +47,17 @@ extern "C" {
             {   "Delay Time (ms)",  Parameter::ROTARY, 10, 1000, 0.0, { 120,230,70,70 }  },//14
             {   "Delay Output %",  Parameter::ROTARY, 0, 200, 100, { 200,230,70,70 }  },//15
             {   "Gated Output %",  Parameter::ROTARY, 0, 100, 100, { 280,230,70,70 }  },//16
+            {   "Detector (ms)",  Parameter::ROTARY, 0.1, GateEngineBase::kMaxDetectorWindow, 1, { 290,350,60,60 }  },//17
+            {   "Lookahead (ms)",  Parameter::ROTARY, 0, GateEngineBase::kMaxLookahead, 0, { 290,430,60,60 }  },//18
+            {   "Channel Link",  Parameter::MENU, {"Linked", "Unlinked"}, { 270,45,100,20 } },//19
+            {   "Gate Bands",  Parameter::MENU, {"Broadband", "Multiband"}, { 380,20,100,20 } },//20
         };
 
+        //  presets list every control in order; the meters (0, 1) are not set by a preset
         const Presets PRESETS = {
-            { "Preset 1", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
-            { "Preset 2", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
-            { "Preset 3", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
+            { "Tight Drums",   { 0, 0, -30, -6, 0.5, 20, 30, -80, 0, 200, 1000, 1000, 1500, 0, 10, 0, 100, 1, 2, 0, 0 } },
+            { "Vocal Cleanup", { 0, 0, -45, -10, 5, 150, 80, -20, 0, 200, 1000, 1500, 2500, 0, 10, 0, 100, 5, 0, 0, 0 } },
+            { "Gated Echo",    { 0, 0, -35, -6, 2, 50, 50, -60, 1, 500, 1000, 1000, 800, 0.5, 250, 100, 100, 1, 0, 0, 0 } },
         };
 
         return (APDI::Effect*)new MyEffect(CONTROLS, PRESETS);
@@ -64,21 +69,16 @@ MyEffect::MyEffect(const Parameters& parameters, const Presets& presets)
 : Effect(parameters, presets)
 {
     // Initialise member variables, etc.
-    iMeasuredLength = iMeasuredItems = 0;
-    fMax0 = fMax1 = fMaxOldL = fMaxOldR = 0;
-    fOutMultiplier = 0;
-    fOutMultiplierOld = 0;
-    
-    iBufferSize = 2 * getSampleRate();
-            
-    pfCircularBuffer = new float[iBufferSize];
-    for(int x = 0; x < iBufferSize; x++)
-        pfCircularBuffer[x] = 0;
-            
-    iBufferWritePos = 0;
-    
-    bBandPass = true;
+    iFilterItem = SidechainFilter::BANDPASS;
+    iLinkItem = GateEngineBase::LINKED;
+    iBandsItem = GateEngineBase::BROADBAND;
+    snapshot.setOutput<L_METER>();  // process() writes the meters
+    snapshot.setOutput<R_METER>();
+    pfMeterLevel[0] = pfMeterLevel[1] = 0;
     
+    iPendingPreset = -1;
+    fMorphTime = 0;
+    prepare(getSampleRate());
 }
 
 // Destructor: called when the effect is terminated / unloaded
@@ -87,41 +87,62 @@ MyEffect::~MyEffect()
     // Put your own additional clean up code here (e.g. free memory)
 }
 
+void MyEffect::prepare(float fSampleRate)
+{
+    stk::Stk::setSampleRate(fSampleRate);
+    engine.prepare(fSampleRate);
+    
+    //the presets are compiled for this rate
+    programs.clear();
+    for (const Preset& preset : presets){
+        ParameterSnapshot<NUM_CONTROLS> values;
+        values.capture(preset.values);
+        programs.push_back(Engine::compile(makeSettings(values), fSampleRate));
+    }
+    iPendingPreset = -1;
+}
+
 // EVENT HANDLERS: handle different user input (button presses, preset selection, drop menus)
 
 void MyEffect::presetLoaded(int iPresetNum, const char *sPresetName)
 {
-    // A preset has been loaded, so you could perform setup, such as retrieving parameter values
-    // using getParameter and use them to set state variables in the plugin
+    // the host has already set the controls to the preset; process() puts the compiled preset in
+    // place at the start of the next block instead of working it out from the controls
+    if (iPresetNum >= 0 && iPresetNum < (int)programs.size()){
+        
+        //the menus follow the preset too, whether or not the host called optionChanged() for them,
+        //so later control changes are worked out with the preset's choices
+        const Engine::Settings& preset = programs[iPresetNum].settings;
+        iFilterItem = preset.filterType;
+        iLinkItem = preset.link;
+        iBandsItem = preset.bands;
+        
+        iPendingPreset = iPresetNum;
+    }
 }
 
 void MyEffect::optionChanged(int iOptionMenu, int iItem)
 {
     // logic for filter selection
-       iOptionMenu = parameters[8];
-       if (iItem == 0){
-           
-           bBandPass = true;
-           bLowPass = false;
-           bHighPass = false;
-           
-       }
+    if (iOptionMenu == FILTER_TYPE){
+        
+        iFilterItem = iItem;
+        
+    }
     
-       if (iItem == 1){
-           
-           bBandPass = false;
-           bLowPass = true;
-           bHighPass = false;
-           
-       }
+    // linked: one gain for every channel, unlinked: each channel gates itself
+    if (iOptionMenu == CHANNEL_LINK){
+        
+        iLinkItem = iItem;
+        
+    }
     
-       if (iItem == 2){
-           
-           bBandPass = false;
-           bLowPass = false;
-           bHighPass = true;
-           
-       }
+    // broadband: one gain from the filtered key, multiband: every band gates itself
+    if (iOptionMenu == GATE_BANDS){
+        
+        iBandsItem = iItem;
+        
+    }
 
 }
 
@@ -138,208 +159,103 @@ void MyEffect::buttonPressed(int iButton)
 
 // Applies audio processing to a buffer of audio
 // (inputBuffer contains the input audio, and processed samples should be stored in outputBuffer)
+//
+// The controls are read once, at the start of the block, and handed to the engine only when
+// one of them has moved, so the engine works out its coefficients again only then; the gain
+// controls glide to their new values inside the engine (see GateEngine.h). A preset that has
+// just been loaded goes in already compiled. The engine scales the meter level as it goes, and
+// it is written to the meters once, at the end of the block; the dB readings go out through the
+// engine's telemetry ring to pollMeters().
 void MyEffect::process(const float** inputBuffers, float** outputBuffers, int numSamples)
 {
-    iMeasuredLength = (0.001 * getSampleRate());
-    float fIn0, fIn1, fOut0 = 0, fOut1 = 0;
-    const float *pfInBuffer0 = inputBuffers[0], *pfInBuffer1 = inputBuffers[1];
-    float *pfOutBuffer0 = outputBuffers[0], *pfOutBuffer1 = outputBuffers[1];
-    
-    
-    float fAval;
-    
-    float fMix;
-    float fMixSidechain;
-    float fFilteredMix = 0;
-    float fThresh(parameters[2]);
-    float fThreshRec;
-    float fGateHyst(parameters[3]);
-    float fGateHystRec;
-    float fReductionAmount(parameters[7]);
-    float fReductionAmountRec;
-    float fAttack(parameters[4]);
-    float fRelease(parameters[6]);
-    float fHold(parameters[5]);
-
-    LPF filterlpf;
-    HPF filterhpf;
-    BPF filterbpf;
-    
-    //for the delay
-    float fAval0;
-    float fAval1;
-    float fSR = getSampleRate();
-    int iBufferReadPos;
-    float fDelaySignal;
-    float fDelayAmount;
-    float fDelayTime = (parameters[14] / 1000); // converts to ms
-    float fDelayTimeBPM = (60000 / parameters[17]);
-    float fOutDel;
-    float fDry(parameters[16] / 100);
-    float fWet(parameters[15] / 100);
-     
-    //float fGain = parameters[0];
-    
-    while(numSamples--)
-    {
-        // Get sample from input
-        fIn0 = *pfInBuffer0++;
-        fIn1 = *pfInBuffer1++;
- 
-        //creates a mix for the gating and a mix for the delay buffer
-        fMix = fIn0 + fIn1 * 0.5;
-        fMixSidechain = fIn0 + fIn1 * 0.5;
-        
-        //assigns parameters to the filters
-        filterlpf.setCutoff(parameters[9]);
-        filterhpf.setCutoff(parameters[10]);
-        filterbpf.set(parameters[11], parameters[12]);
-        //logic for filter switching
-        if (bLowPass == true) {
-            fFilteredMix = filterlpf.tick(fMix);
-        }
-        if (bHighPass == true) {
-            fFilteredMix = filterhpf.tick(fMix);
-        }
-        if (bBandPass == true) {
-            fFilteredMix = filterbpf.tick(fMix);
-        }
-        //rectifies and scales threshold, hysteresis and reduction amount
-        fThreshRec = (fThresh + 100) / 100;
-        fGateHystRec = fabs(fGateHyst) / 100;
-        fReductionAmountRec = (fReductionAmount + 100) / 100;
-        
-        //peak detection for the noise gate, converts detected peaks into a log
-        fAval = fabs(fFilteredMix);
-        fAval = 20 * log10(fAval) + 100;
-        fAval = fAval / 100;
-        
-        if (fAval > fMax ) {
-            
-            fMax = fAval;
-            
-        }
-        //peak detction for the metering
-        
-        fAval0 = fabs(fIn0);
-        fAval1 = fabs(fIn1);
-        
-        if (fAval0 > fMax0 ) {
-            
-            fMax0 = fAval0;
-            
-        }
-        if (fAval1 > fMax1 ) {
-            
-            fMax1 = fAval1;
-            
-        }
-       //
-        iMeasuredItems++; //steps through the measured items
-        
-        if (iMeasuredItems == iMeasuredLength){
-            
-            if (fHoldCounter <= 0){
-                
-                fHoldCounter = 0; //keeps the hold counter at 0 (explained below)
-                
-            }
-            
-            if (fMax > (fThreshRec) ){
-                
-                fHoldCounter = 1.0; //sets the hold counter to 1 every time the gate is open
-            
-                fOutMultiplier = (fOutMultiplier + secToValue(fAttack)); // ramps up the multiplier according to user input
-                
-                if (fOutMultiplier >= 1){
-                    fOutMultiplier = 1; // this limits the mult so the user doesnt go deaf
-                    
-                }
-            }
-            
-            fHoldCounter = (fHoldCounter - secToValue(fHold)); // always counts down at a rate set by the user until it reaches 0
-            
-            if (fMax < (fThreshRec - fGateHystRec) && fHoldCounter <= 0){
-                    
-                    fOutMultiplier = (fOutMultiplier - secToValue(fRelease)); //subtracts the multiplier at a rate set by the user
-                
-                    if (fOutMultiplier <= fReductionAmountRec){
-                        
-                        fOutMultiplier = fReductionAmountRec; //keeps the lowest value of the multiplier at the reduction amount set by the user
-                        
-                    }
-                
-            }
-            
-            //Code for making the metering look nice
-            fMax0 = fMax0 * fOutMultiplier;
-            fMax1 = fMax1 * fOutMultiplier; //not sure if this step is needed / could be re written to use the actual output from the gate
+    takeControls();
+    engine.process(inputBuffers, outputBuffers, numSamples, getSampleRate());
+    publishMeters();
+}
 
-            fMax0 = (fMax0 * 39 + 1);
-            fMax1 = (fMax1 * 39 + 1);
+void MyEffect::processPcm(const void* input, pcm::Format inputFormat, void* output, pcm::Format outputFormat, int numFrames)
+{
+    takeControls();
+    engine.processPcm(input, inputFormat, output, outputFormat, numFrames, getSampleRate());
+    publishMeters();
+}
 
-            fMax0 = log10(fMax0);
-            fMax1 = log10(fMax1);
+// reads the controls at the start of a block and hands the engine a preset or any changed values
+void MyEffect::takeControls()
+{
+    snapshot.capture(parameters);
+    snapshot.set<FILTER_TYPE>(iFilterItem);
+    snapshot.set<CHANNEL_LINK>(iLinkItem);
+    snapshot.set<GATE_BANDS>(iBandsItem);
+    
+    int iPreset = iPendingPreset.exchange(-1);
+    if (iPreset >= 0){
+        //the controls the host changed for the preset are taken in with it
+        const Engine::Program& program = programs[iPreset];
+        settings = program.settings;
+        engine.loadProgram(program, fMorphTime * getSampleRate());
+    }
+    else if (snapshot.anyChanged()){
+        settings = makeSettings(snapshot);
+        engine.setSettings(settings);
+    }
+}
 
-            fMax0 = (fMax0 / log10(40));
-            fMax1 = (fMax1 / log10(40)); //this and above scales and offsets the values into a useable range
+// the engine settings for a set of control values
+MyEffect::Engine::Settings MyEffect::makeSettings(const ParameterSnapshot<NUM_CONTROLS>& controls)
+{
+    Engine::Settings settings;
+    settings.fThreshDb = controls.get<THRESHOLD>();
+    settings.fHystDb = controls.get<HYSTERESIS>();
+    settings.fAttack = controls.get<ATTACK>();
+    settings.fHold = controls.get<HOLD>();
+    settings.fRelease = controls.get<RELEASE>();
+    settings.fReductionDb = controls.get<REDUCTION>();
+    settings.filterType = (SidechainFilter::Type)(int)controls.get<FILTER_TYPE>();
+    settings.fLowPass = controls.get<LPF_CUTOFF>();
+    settings.fHighPass = controls.get<HPF_CUTOFF>();
+    settings.fCentre = controls.get<BP_CENTRE>();
+    settings.fWidth = controls.get<BP_WIDTH>();
+    settings.fFeedback = controls.get<DELAY_FEEDBACK>();
+    settings.fDelayTime = controls.get<DELAY_TIME>();
+    settings.fWetPercent = controls.get<DELAY_OUTPUT>();
+    settings.fDryPercent = controls.get<GATED_OUTPUT>();
+    settings.fDetector = controls.get<DETECTOR>();
+    settings.fLookahead = controls.get<LOOKAHEAD>();
+    settings.link = (GateEngineBase::Link)(int)controls.get<CHANNEL_LINK>();
+    settings.bands = (GateEngineBase::Bands)(int)controls.get<GATE_BANDS>();
+    return settings;
+}
 
-            //Making the slow decay
-            if (fMax0 < fMaxOldL){
-                fMax0 = (fMax0 * 0.01 + fMaxOldL * 0.99);
-            }
-            if (fMax1 < fMaxOldR){
-                fMax1 = (fMax1 * 0.01 + fMaxOldR * 0.99);
-            }
+// on the audio thread, at the end of a block: the L / R meters show the engine's meter level
+void MyEffect::publishMeters()
+{
+    for (int c = 0; c < 2; c++){
+        float fLevel = engine.getMeterLevel(c);
+        parameters[L_METER + c] = fLevel; //output to the meters
+        pfMeterLevel[c] = fLevel;
+    }
+}
 
-            parameters[0] = fMax0;
-            parameters[1] = fMax1; //output to the meters
+// Level monitoring: on the host's UI or monitoring thread, takes the readings the audio thread
+// has sent since the last call and works out the dB levels and reduction history. The lock also
+// keeps the telemetry ring to one reader, whichever threads call this.
+int MyEffect::pollMeters()
+{
+    std::lock_guard<std::mutex> lock(meterMutex);
+    return meters.poll(engine.getTelemetry());
+}
 
-            fMaxOldL = fMax0;
-            fMaxOldR = fMax1;
+void MyEffect::getReductionHistory(int iChannel, float *pfOut, int iCount)
+{
+    std::lock_guard<std::mutex> lock(meterMutex);
+    meters.getReductionHistory(iChannel, pfOut, iCount);
+}
 
-            fMax0 = 0;
-            fMax1 = 0;
-            fMax = 0;
-            iMeasuredItems = 0;
-            fOutMultiplierOld = fOutMultiplier; //resetting variables for the next loop
-        }
-        
-        //Code for the delay
-        iBufferReadPos = iBufferWritePos - (fSR * fDelayTime); //sets the read point behind the write point according to user spec, since sample rate is per second, just need to multiply by the ms value
-                
-        if (iBufferReadPos < 0 ){
-                            
-            iBufferReadPos  += iBufferSize;
-                            
-        }
-        
-        fDelaySignal = pfCircularBuffer[iBufferReadPos]; //reads the buffer output
-                        
-        fDelayAmount = parameters[13];
-                        
-        fOutDel = (fDelaySignal * fDelayAmount); //multiplies the buffer output by the delay feedback value
-            
-        //adding wet and dry
-        fMix = (fMix * fOutMultiplier) * fDry; //creates an output for the gate using the multiplier and the gain
-            
-        fMixSidechain = (fMixSidechain + fOutDel) * 0.5; // copys the delay back into itself
-            
-        pfCircularBuffer[iBufferWritePos] = fMixSidechain; // writes the feedback signal back into the buffer
-                        
-        iBufferWritePos++;
-                        
-        if (iBufferWritePos == iBufferSize - 1){
-                            
-            iBufferWritePos = 0;
-                            
-        } // resets the delay buffer back to the start
-            
-        fOut0 = (fMix + (fOutDel * fWet)) * 0.5;
-        fOut1 = (fMix + (fOutDel * fWet)) * 0.5; //mixes the delay signal and the gate signal
-        
-        // Copy result to output
-        *pfOutBuffer0++ = fOut0;
-        *pfOutBuffer1++ = fOut1;
-    }
+void MyEffect::getOutputLevels(int iChannel, float& fPeakDb, float& fTruePeakDb, float& fRmsDb)
+{
+    std::lock_guard<std::mutex> lock(meterMutex);
+    fPeakDb = meters.getPeakDb(iChannel);
+    fTruePeakDb = meters.getTruePeakDb(iChannel);
+    fRmsDb = meters.getRmsDb(iChannel);
 }
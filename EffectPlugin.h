@@ -12,50 +12,108 @@
 using namespace APDI;
 
 #include "EffectExtra.h"
+#include "GateEngine.h"
+#include "ParameterSnapshot.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 class MyEffect : public APDI::Effect
 {
 public:
+    // the controls, in the order they are listed in createEffect()
+    enum Controls {
+        L_METER, R_METER,
+        THRESHOLD, HYSTERESIS, ATTACK, HOLD, RELEASE, REDUCTION,
+        FILTER_TYPE, LPF_CUTOFF, HPF_CUTOFF, BP_CENTRE, BP_WIDTH,
+        DELAY_FEEDBACK, DELAY_TIME, DELAY_OUTPUT, GATED_OUTPUT,
+        DETECTOR, LOOKAHEAD, CHANNEL_LINK, GATE_BANDS,
+        NUM_CONTROLS
+    };
+    
+
     MyEffect(const Parameters& parameters, const Presets& presets); // constructor (initialise variables, etc.)
     ~MyEffect();                                                    // destructor (clean up, free memory, etc.)
 
-    void setSampleRate(float sampleRate){ stk::Stk::setSampleRate(sampleRate); }
+    void setSampleRate(float sampleRate){ prepare(sampleRate); }
     float getSampleRate() const { return stk::Stk::sampleRate(); };
     
+    // sizes everything for a sample rate, compiles the presets for it and starts from silence
+    // (allocates: call while process() is not running); process() itself never allocates
+    void prepare(float fSampleRate);
+    
+    // back to silence, with the same settings (e.g. when the transport stops; no allocation)
+    void reset() { engine.reset(); }
+    
     void process(const float** inputBuffers, float** outputBuffers, int numSamples);
     
+    // the same straight from and to interleaved stereo integer PCM (e.g. a capture and a playout
+    // buffer), converting inside the engine rather than in separate passes (see PcmKernels.h)
+    void processPcm(const void* input, pcm::Format inputFormat, void* output, pcm::Format outputFormat, int numFrames);
+    
     void presetLoaded(int iPresetNum, const char *sPresetName);
     void optionChanged(int iOptionMenu, int iItem);
     void buttonPressed(int iButton);
-    float fAval0;
-    float fAval1;
-    float fOutMultiplier;
-    float fOutMultiplierOld;
-    float fMax;
-    float fHoldCounter;
-    
-    float secToValue(float attackTime) {
-        float attackValue;
-        attackValue = ((getSampleRate() / attackTime) / 1000) / iMeasuredLength; // function calculates the amount of samples per s in the first brackets, then divides by 1000 to convert to ms, then divides my the length of the buffer to get the value to be added to a range of 0 - 1 in order to reach 0 or 1
-        
-        return attackValue;
-        
-    }
-    
-    bool bHighPass;
-    bool bBandPass;
-    bool bLowPass;
     
-
+    // Latency added by the lookahead (or the multiband gate's frame), in samples; it changes with
+    // "Lookahead (ms)" and "Gate Bands". The APDI plugin interface has no way to report latency,
+    // so nothing tells the host about it: a host that wants the output in line with its other
+    // tracks must read this itself (again after any control change) and delay them to match.
+    int getLatencySamples() const { return engine.getLatencySamples(); }
+    
+    // the level the "L Meter" / "R Meter" controls show (0..1) as of the end of the last block;
+    // process() writes it to the controls itself, and this reads it safely from any thread
+    float getMeterLevel(int iChannel) const { return pfMeterLevel[iChannel]; }
+    
+    // Level monitoring: takes the readings the audio thread has sent since the last call and
+    // works out the dB levels and reduction history below; returns how many 1 ms windows there
+    // were. Call it from the host's UI timer or monitoring thread, never the audio thread, every
+    // 20 ms or so (the engine keeps a quarter of a second). The meter controls do not need it.
+    int pollMeters();
+    
+    // last iCount ms of gate gain reduction on a channel (dB, oldest first, iCount <= 1024);
+    // for monitoring, from any thread but the audio thread
+    void getReductionHistory(int iChannel, float *pfOut, int iCount);
+    
+    // the output level of a channel over the last 1 ms: sample peak and RMS (dBFS) and 4x
+    // oversampled true peak (dBTP, see TruePeak.h); from any thread but the audio thread
+    void getOutputLevels(int iChannel, float& fPeakDb, float& fTruePeakDb, float& fRmsDb);
+    
+    // how long a preset change takes to glide from the current sound to the new preset, in
+    // seconds (0, the default, switches at the next block)
+    void setPresetMorphTime(float fSeconds) { fMorphTime = fSeconds; }
+    
+    // cycles spent in each stage of process(), from any thread (needs a MYEFFECT_PROFILE build)
+    StageProfiler& getProfile() { return engine.getProfile(); }
+    
 private:
+    void takeControls();
+    void publishMeters();
+    typedef GateEngine<2> Engine; // the host runs the effect on a stereo bus
+    
+    static Engine::Settings makeSettings(const ParameterSnapshot<NUM_CONTROLS>& controls);
+    
     // Declare shared member variables here
-    float *pfCircularBuffer;
-    float fSR;
-    int iMeasuredLength, iMeasuredItems;
-    float fMax0, fMax1, fMaxOldL, fMaxOldR;
-    int iBufferSize, iBufferWritePos;
+    Engine engine;              // gate, meters and delay for both channels
+    Engine::Settings settings;  // control values handed to the engine when any of them change
+    ParameterSnapshot<NUM_CONTROLS> snapshot; // the controls as read at the start of each block
+    std::atomic<int> iFilterItem, iLinkItem, iBandsItem;  // menu selections, from optionChanged()
+    
+    // the presets, compiled when the effect is created, so loading one calculates nothing
+    std::vector<Engine::Program> programs;
+    std::atomic<int> iPendingPreset;          // preset to put in place at the next block (-1: none)
+    std::atomic<float> fMorphTime;
+    
+    std::atomic<float> pfMeterLevel[2];       // the meter controls' level, for getMeterLevel()
+    
+    // the dB levels and reduction history are worked out by pollMeters(), on the thread that
+    // calls it, from the engine's telemetry; the lock keeps the readers out while it does
+    MeterDisplay<2> meters;
+    std::mutex meterMutex;
     
 };
 
 
 
+
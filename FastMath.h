@@ -0,0 +1,171 @@
+//
+//  FastMath.h
+//  MyEffect Fast dB Maths
+//
+//  Approximate log2 / exp2 and the dB conversions built on them, for the places where the
+//  plugin really needs dB values (meters, reduction depth). Accuracy against libm is checked by
+//  bench/mathcheck.cpp, over gains of -180..+60 dB and dB values of -140..+24 dB:
+//    log2 / log10 : absolute error < 4e-6 / 2e-6, gainToDb within 4e-5 dB
+//    exp2         : relative error < 2e-7, dbToGain relative error < 1e-6
+//  Each function has a scalar form and a block form; the block forms use AVX2 or SSE2 when
+//  available and fall back to the scalar form otherwise.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace fastmath {
+
+// log2(1 + t) for t in [0, 1), and 2^f for f in [0, 1): Chebyshev-node fits
+static const float kLog2C[7] = { 2.4434387e-06f, 1.4424535f, -0.71731278f, 0.45450849f, -0.27269756f, 0.11761308f, -0.024568535f };
+static const float kExp2C[6] = { 0.99999990f, 0.69315449f, 0.24014182f, 0.055860337f, 0.0089495904f, 0.0018937541f };
+
+static const float kLog10Of2 = 0.30102999566f;       // log10(x) = log2(x) * kLog10Of2
+static const float kDbPerLog2 = 6.0205999133f;       // 20 * log10(2)
+static const float kLog2PerDb = 0.16609640474f;      // 1 / kDbPerLog2
+
+// log2 of a positive value (0 and denormals come out near -127)
+inline float log2(float fIn)
+{
+    uint32_t uBits;
+    memcpy(&uBits, &fIn, 4);
+    float fExponent = (float)((int)((uBits >> 23) & 0xFF) - 127);
+    uBits = (uBits & 0x007FFFFF) | 0x3F800000; // mantissa as a value in [1, 2)
+    float fMantissa;
+    memcpy(&fMantissa, &uBits, 4);
+
+    float t = fMantissa - 1.0f;
+    float p = kLog2C[6];
+    for (int c = 5; c >= 0; c--)
+        p = p * t + kLog2C[c];
+    return fExponent + p;
+}
+
+// 2^fIn, for fIn clamped to the normal float range
+inline float exp2(float fIn)
+{
+    if (fIn < -126.0f) fIn = -126.0f;
+    if (fIn > 127.0f) fIn = 127.0f;
+
+    int iWhole = (int)fIn;
+    if ((float)iWhole > fIn) iWhole--; // floor
+    float f = fIn - (float)iWhole;
+
+    float p = kExp2C[5];
+    for (int c = 4; c >= 0; c--)
+        p = p * f + kExp2C[c];
+
+    uint32_t uBits = (uint32_t)(iWhole + 127) << 23;
+    float fScale;
+    memcpy(&fScale, &uBits, 4);
+    return p * fScale;
+}
+
+inline float log10(float fIn) { return log2(fIn) * kLog10Of2; }
+inline float gainToDb(float fGain) { return log2(fGain) * kDbPerLog2; }
+inline float dbToGain(float fDb) { return exp2(fDb * kLog2PerDb); }
+
+#if defined(__AVX2__)
+
+inline __m256 log2(__m256 in)
+{
+    __m256i bits = _mm256_castps_si256(in);
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xFF)), _mm256_set1_epi32(127)));
+    __m256 t = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000))), _mm256_set1_ps(1.0f));
+
+    __m256 p = _mm256_set1_ps(kLog2C[6]);
+    for (int c = 5; c >= 0; c--)
+        p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(kLog2C[c]));
+    return _mm256_add_ps(exponent, p);
+}
+
+inline __m256 exp2(__m256 in)
+{
+    in = _mm256_min_ps(_mm256_max_ps(in, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+    __m256 whole = _mm256_floor_ps(in);
+    __m256 f = _mm256_sub_ps(in, whole);
+
+    __m256 p = _mm256_set1_ps(kExp2C[5]);
+    for (int c = 4; c >= 0; c--)
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(kExp2C[c]));
+
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+#elif defined(__SSE2__)
+
+inline __m128 log2(__m128 in)
+{
+    __m128i bits = _mm_castps_si128(in);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xFF)), _mm_set1_epi32(127)));
+    __m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))), _mm_set1_ps(1.0f));
+
+    __m128 p = _mm_set1_ps(kLog2C[6]);
+    for (int c = 5; c >= 0; c--)
+        p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(kLog2C[c]));
+    return _mm_add_ps(exponent, p);
+}
+
+inline __m128 exp2(__m128 in)
+{
+    in = _mm_min_ps(_mm_max_ps(in, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+    __m128i truncated = _mm_cvttps_epi32(in);
+    __m128 whole = _mm_cvtepi32_ps(truncated);
+    __m128 below = _mm_cmpgt_ps(whole, in); // truncation rounded negative values up, so floor them
+    whole = _mm_sub_ps(whole, _mm_and_ps(below, _mm_set1_ps(1.0f)));
+    __m128 f = _mm_sub_ps(in, whole);
+
+    __m128 p = _mm_set1_ps(kExp2C[5]);
+    for (int c = 4; c >= 0; c--)
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(kExp2C[c]));
+
+    __m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(whole), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+#endif
+
+// block forms (pfOut may be the same buffer as pfIn):
+//   log2: pfOut[i] = log2(pfIn[i]) * fScale
+//   exp2: pfOut[i] = exp2(pfIn[i] * fScale)
+inline void log2(const float *pfIn, float *pfOut, int iCount, float fScale = 1.0f)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_mul_ps(log2(_mm256_loadu_ps(pfIn + i)), _mm256_set1_ps(fScale)));
+#elif defined(__SSE2__)
+    for (; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_mul_ps(log2(_mm_loadu_ps(pfIn + i)), _mm_set1_ps(fScale)));
+#endif
+    for (; i < iCount; i++)
+        pfOut[i] = log2(pfIn[i]) * fScale;
+}
+
+inline void exp2(const float *pfIn, float *pfOut, int iCount, float fScale = 1.0f)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, exp2(_mm256_mul_ps(_mm256_loadu_ps(pfIn + i), _mm256_set1_ps(fScale))));
+#elif defined(__SSE2__)
+    for (; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, exp2(_mm_mul_ps(_mm_loadu_ps(pfIn + i), _mm_set1_ps(fScale))));
+#endif
+    for (; i < iCount; i++)
+        pfOut[i] = exp2(pfIn[i] * fScale);
+}
+
+inline void gainToDb(const float *pfIn, float *pfOut, int iCount) { log2(pfIn, pfOut, iCount, kDbPerLog2); }
+inline void dbToGain(const float *pfIn, float *pfOut, int iCount) { exp2(pfIn, pfOut, iCount, kLog2PerDb); }
+
+} // namespace fastmath
@@ -0,0 +1,381 @@
+//
+//  GateBatch.h
+//  MyEffect Batched Gate Engine
+//
+//  Runs Lanes independent stereo gates (each the equivalent of one linked MyEffect, with its
+//  own Settings) in one call. The parts of the gate that are a recurrence from one sample to
+//  the next - the sidechain biquad and the gate envelope - cannot be vectorised within one
+//  channel, so here they run across instances instead: one instance per SIMD lane, with every
+//  piece of state held as an array over the lanes and the loops over lanes written with a
+//  fixed trip count so they compile to whole vectors. The stages that are already block-wide
+//  (detector, lookahead, gain, echo, meters) run per instance as in GateEngine.
+//
+//  The lane loops use the same expressions as the scalar code. What is checked (by bench/batch)
+//  is that each instance's output is identical to a MyEffect's for the settings batch uses:
+//  linked, broadband, no lookahead, a gate that reduces, and input that is never silent. Outside
+//  those, GateBatch is not a drop-in for GateEngine: it has none of GateEngine's shortcuts - an
+//  idle channel, a bypassed gate at 0 dB reduction, a parked sidechain - and runs every lane's
+//  full gate every block. The Settings link and bands fields are ignored: batched instances are
+//  always linked and broadband. Whether a batch is faster than separate instances depends on
+//  the machine and the mix of settings; bench/batch measures it.
+//
+
+#pragma once
+
+#include "GateEngine.h"
+
+template <int Lanes>
+class GateBatch : public GateEngineBase
+{
+    static_assert(Lanes == 4 || Lanes == 8 || Lanes == 16, "batches are 4, 8 or 16 instances (whole SSE / AVX / AVX-512 vectors)");
+
+public:
+    static const int kLanes = Lanes;
+
+    GateBatch()
+    : fSampleRate(0), iMeasuredLength(0), iMeasuredItems(0), fMaxDelayTime(kMaxDelayTime), delayStorage(MultiTapDelay::FLOAT32),
+      iGridPhase(0)
+    {
+        for (int l = 0; l < Lanes; l++) {
+            sidechain[l].setRampLength(kBlockSize);
+            pfZ1[l] = pfZ2[l] = 0;
+            pbSettingsChanged[l] = false;
+            pfEnvelopeState[l] = pfHoldState[l] = 0;
+            piStage[l] = GateEnvelope::CLOSED;
+            piLookahead[l] = 0;
+            for (int c = 0; c < 2; c++)
+                pfMeterPeak[l][c] = pfMeterTruePeak[l][c] = pfMeterSquares[l][c] = 0;
+        }
+    }
+
+    // sizes every buffer for this sample rate and starts again from silence (allocates: not for
+    // the audio thread); every instance's settings are worked out for the rate at the next process()
+    void prepare(float fRate)
+    {
+        fSampleRate = fRate;
+        float fMaxRate = fRate > kMaxSampleRate ? fRate : kMaxSampleRate;
+        for (int l = 0; l < Lanes; l++) {
+            detector[l].setMaxLength(0.001 * kMaxDetectorWindow * fMaxRate);
+            for (int c = 0; c < 2; c++) {
+                echo[l][c].setMaxDelay(0.001 * fMaxDelayTime * fRate, kBlockSize, delayStorage);
+                lookahead[l][c].setMaxDelay(0.001 * kMaxLookahead * fMaxRate, kBlockSize);
+            }
+            pbSettingsChanged[l] = true;
+        }
+        reset();
+    }
+
+    // how every instance's echo lines are sized from the next prepare(), as GateEngine::setDelayOptions()
+    void setDelayOptions(float fMaxMs, MultiTapDelay::Storage storage)
+    {
+        fMaxDelayTime = fMaxMs > kMinDelayTime ? fMaxMs : kMinDelayTime;
+        delayStorage = storage;
+    }
+
+    // memory taken by every instance's echo lines, in bytes
+    size_t getDelayBytes() const
+    {
+        size_t uBytes = 0;
+        for (int l = 0; l < Lanes; l++)
+            uBytes += echo[l][0].getBufferBytes() + echo[l][1].getBufferBytes();
+        return uBytes;
+    }
+
+    // back to silence with the same settings (no allocation)
+    void reset()
+    {
+        for (int l = 0; l < Lanes; l++) {
+            gains[l].reset();
+            detector[l].reset();
+            pfZ1[l] = pfZ2[l] = 0;
+            pfEnvelopeState[l] = pfHoldState[l] = 0;
+            piStage[l] = GateEnvelope::CLOSED;
+            for (int c = 0; c < 2; c++) {
+                echo[l][c].reset();
+                lookahead[l][c].reset();
+                meterTruePeak[l][c].reset();
+                pfMeterPeak[l][c] = pfMeterTruePeak[l][c] = pfMeterSquares[l][c] = 0;
+            }
+        }
+        iMeasuredItems = 0;
+        iGridPhase = 0;
+    }
+
+    // control values for one instance, picked up at the start of the next grid block (see GateEngine::process())
+    void setSettings(int iInstance, const Settings& newSettings)
+    {
+        settings[iInstance] = newSettings;
+        pbSettingsChanged[iInstance] = true;
+    }
+
+    int getLatencySamples(int iInstance) const { return piLookahead[iInstance]; }
+    MeterRing<2>& getTelemetry(int iInstance) { return telemetry[iInstance]; }
+    StageProfiler& getProfile() { return profiler; } // every instance together (see GateEngine)
+
+    // ppIn / ppOut hold 2 * Lanes buffers of iCount samples: instance l uses [2l] and [2l + 1]
+    // (an output may be the same buffer as its input). Internal blocks follow the same fixed grid
+    // as GateEngine, so the output does not depend on the host's block size.
+    void process(const float* const* ppIn, float* const* ppOut, int iCount, float fRate)
+    {
+        DenormalGuard denormals;
+        PROFILE_BEGIN(profiler);
+
+        for (int iDone = 0; iDone < iCount; )
+        {
+            int iBlock = (iCount - iDone) < kBlockSize - iGridPhase ? (iCount - iDone) : kBlockSize - iGridPhase;
+            if (iGridPhase == 0)
+                applySettings(fRate);
+
+            {
+                PROFILE_STAGE(profiler, SIDECHAIN);
+
+                //linked key for every instance, the mean of its two channels
+                for (int l = 0; l < Lanes; l++) {
+                    simd::add(ppIn[2 * l] + iDone, ppIn[2 * l + 1] + iDone, pfKeyBlock[l], iBlock);
+                    simd::scale(pfKeyBlock[l], 0.5f, pfKeyBlock[l], iBlock);
+                }
+
+                toLanes(iBlock);
+                filterLanes(iBlock);
+                fromLanes(iBlock);
+            }
+            {
+                PROFILE_STAGE(profiler, DETECTOR);
+
+                //peak of each sidechain over its detector window
+                for (int l = 0; l < Lanes; l++)
+                    detector[l].process(pfKeyBlock[l], pfKeyBlock[l], iBlock);
+            }
+            {
+                PROFILE_STAGE(profiler, GATE);
+                toLanes(iBlock);
+                gateLanes(iBlock);
+                fromLanes(iBlock); //pfKeyBlock now holds every instance's gain
+            }
+            for (int l = 0; l < Lanes; l++) {
+                BlockGains blockGains = gains[l].next(iBlock);
+                OutputKernel kernel = outputKernel(GATE_ACTIVE, echoMode(blockGains, echo[l][0]));
+
+                for (int c = 0; c < 2; c++) {
+                    const float *pfDry = ppIn[2 * l + c] + iDone;
+                    if (piLookahead[l] > 0) {
+                        PROFILE_STAGE(profiler, DELAY);
+                        lookahead[l][c].process(pfDry, pfDryBlock, iBlock);
+                        pfDry = pfDryBlock;
+                    }
+                    kernel(pfDry, pfKeyBlock[l], echo[l][c], blockGains, ppOut[2 * l + c] + iDone, iBlock, scratch, profiler);
+                }
+            }
+            {
+                PROFILE_STAGE(profiler, METERS);
+                meterBlock(ppOut, iDone, iBlock);
+            }
+
+            iDone += iBlock;
+            iGridPhase = iGridPhase + iBlock < kBlockSize ? iGridPhase + iBlock : 0;
+        }
+        PROFILE_END(profiler, iCount, fSampleRate);
+    }
+
+private:
+    // works out what follows from the control values of every instance whose settings changed
+    // (or all of them, if the rate did)
+    void applySettings(float fRate)
+    {
+        bool bRateChanged = fRate != fSampleRate;
+        fSampleRate = fRate;
+        iMeasuredLength = (0.001 * fSampleRate);
+
+        for (int l = 0; l < Lanes; l++) {
+            if (!pbSettingsChanged[l] && !bRateChanged)
+                continue;
+            pbSettingsChanged[l] = false;
+
+            const Settings& s = settings[l];
+            gate[l].update(s, fSampleRate);
+            gains[l].update(s, fSampleRate);
+
+            detector[l].setLength(0.001 * s.fDetector * fSampleRate);
+
+            int iNewLookahead = 0.001 * s.fLookahead * fSampleRate;
+            if (iNewLookahead > lookahead[l][0].getMaxDelay()) iNewLookahead = lookahead[l][0].getMaxDelay();
+
+            float pfTapSamples[kMaxTaps];
+            tapSamples(s, fSampleRate, pfTapSamples);
+
+            for (int c = 0; c < 2; c++) {
+                if (piLookahead[l] == 0 && iNewLookahead > 0)
+                    lookahead[l][c].reset();
+                lookahead[l][c].setDelay(iNewLookahead);
+                setTaps(echo[l][c], s, pfTapSamples, kDelayGlideTime * 0.001 * fSampleRate);
+            }
+            piLookahead[l] = iNewLookahead;
+
+            sidechain[l].setType(s.filterType);
+            sidechain[l].setSampleRate(fSampleRate);
+            sidechain[l].setLowPass(s.fLowPass);
+            sidechain[l].setHighPass(s.fHighPass);
+            sidechain[l].setBandPass(s.fCentre, s.fWidth);
+        }
+    }
+
+    // pfKeyBlock[lane][sample] -> pfLaneBlock[sample][lane], and back
+    void toLanes(int iCount)
+    {
+        for (int i = 0; i < iCount; i++)
+            for (int l = 0; l < Lanes; l++)
+                pfLaneBlock[i][l] = pfKeyBlock[l][i];
+    }
+    void fromLanes(int iCount)
+    {
+        for (int l = 0; l < Lanes; l++)
+            for (int i = 0; i < iCount; i++)
+                pfKeyBlock[l][i] = pfLaneBlock[i][l];
+    }
+
+    // every instance's sidechain biquad, one sample of all lanes at a time (TDF-II, as SidechainFilter::tick)
+    void filterLanes(int iCount)
+    {
+        alignas(64) float b0[Lanes], b1[Lanes], b2[Lanes], a1[Lanes], a2[Lanes];
+        alignas(64) float d0[Lanes], d1[Lanes], d2[Lanes], e1[Lanes], e2[Lanes];
+        alignas(64) float s1[Lanes], s2[Lanes];
+
+        for (int l = 0; l < Lanes; l++) {
+            SidechainFilter::Coefficients c, delta;
+            sidechain[l].nextBlock(c, delta, iCount); //delta is zero unless this instance's filter is ramping
+            b0[l] = c.b0; b1[l] = c.b1; b2[l] = c.b2; a1[l] = c.a1; a2[l] = c.a2;
+            d0[l] = delta.b0; d1[l] = delta.b1; d2[l] = delta.b2; e1[l] = delta.a1; e2[l] = delta.a2;
+            s1[l] = pfZ1[l];
+            s2[l] = pfZ2[l];
+        }
+
+        for (int i = 0; i < iCount; i++) {
+            float *pfX = pfLaneBlock[i];
+            for (int l = 0; l < Lanes; l++) {
+                b0[l] += d0[l]; b1[l] += d1[l]; b2[l] += d2[l]; a1[l] += e1[l]; a2[l] += e2[l];
+                float fIn = pfX[l];
+                float fOut = b0[l] * fIn + s1[l];
+                s1[l] = b1[l] * fIn - a1[l] * fOut + s2[l];
+                s2[l] = b2[l] * fIn - a2[l] * fOut;
+                pfX[l] = fOut;
+            }
+        }
+
+        for (int l = 0; l < Lanes; l++) {
+            sidechain[l].endBlock(SidechainFilter::Coefficients(b0[l], b1[l], b2[l], a1[l], a2[l])); //where a ramp has got to
+            pfZ1[l] = SidechainFilter::flush(s1[l]);
+            pfZ2[l] = SidechainFilter::flush(s2[l]);
+        }
+    }
+
+    // every instance's gate envelope (GateEnvelope::step, as GateEngine::detectBlock runs it);
+    // pfLaneBlock holds the detector peaks and receives the gains
+    void gateLanes(int iCount)
+    {
+        alignas(64) float pfEnvelope[Lanes], pfHold[Lanes];
+        alignas(64) float pfOpen[Lanes], pfClose[Lanes], pfFloor[Lanes], pfAttack[Lanes], pfRelease[Lanes], pfHoldLength[Lanes];
+        alignas(64) int piLaneStage[Lanes];
+        for (int l = 0; l < Lanes; l++) {
+            pfEnvelope[l] = pfEnvelopeState[l];
+            pfHold[l] = pfHoldState[l];
+            piLaneStage[l] = piStage[l];
+            pfOpen[l] = gate[l].fOpenLevel;
+            pfClose[l] = gate[l].fCloseLevel;
+            pfFloor[l] = gate[l].fFloorGain;
+            pfAttack[l] = gate[l].fAttack;
+            pfRelease[l] = gate[l].fRelease;
+            pfHoldLength[l] = gate[l].fHoldLength;
+        }
+
+        for (int i = 0; i < iCount; i++) {
+            float *pfX = pfLaneBlock[i];
+            for (int l = 0; l < Lanes; l++) {
+                GateEnvelope::step(pfX[l], pfOpen[l], pfClose[l], pfAttack[l], pfRelease[l], pfHoldLength[l], 1,
+                                   pfEnvelope[l], pfHold[l], piLaneStage[l]);
+                pfX[l] = GateEnvelope::gain(pfFloor[l], pfEnvelope[l]);
+            }
+        }
+
+        for (int l = 0; l < Lanes; l++) {
+            pfEnvelopeState[l] = pfEnvelope[l];
+            pfHoldState[l] = pfHold[l];
+            piStage[l] = piLaneStage[l];
+        }
+    }
+
+    // output sample peak, true peak and sum of squares over each 1 ms window, sent to each
+    // instance's telemetry ring with its gain at the end of the window; one instance at a time,
+    // so one block of oversampled peaks does for all of them
+    void meterBlock(const float* const* ppOut, int iOffset, int iCount)
+    {
+        int iItems = iMeasuredItems;
+        for (int l = 0; l < Lanes; l++) {
+            for (int c = 0; c < 2; c++)
+                meterTruePeak[l][c].process(ppOut[2 * l + c] + iOffset, ppfTruePeakBlock[c], iCount);
+
+            iItems = iMeasuredItems; //every instance's windows line up
+            for (int iDone = 0; iDone < iCount; )
+            {
+                int iSegment = iMeasuredLength - iItems;
+                if (iSegment < 1) iSegment = 1;
+                if (iSegment > iCount - iDone) iSegment = iCount - iDone;
+
+                for (int c = 0; c < 2; c++) {
+                    const float *pfOut = ppOut[2 * l + c] + iOffset + iDone;
+                    pfMeterPeak[l][c] = simd::absMax(pfOut, iSegment, pfMeterPeak[l][c]);
+                    pfMeterTruePeak[l][c] = simd::absMax(ppfTruePeakBlock[c] + iDone, iSegment, pfMeterTruePeak[l][c]);
+                    pfMeterSquares[l][c] = simd::sumSquares(pfOut, iSegment, pfMeterSquares[l][c]);
+                }
+
+                iItems += iSegment;
+                iDone += iSegment;
+
+                if (iItems >= iMeasuredLength){
+                    MeterFrame<2> frame;
+                    for (int c = 0; c < 2; c++) {
+                        frame.pfPeak[c] = pfMeterPeak[l][c];
+                        frame.pfTruePeak[c] = pfMeterTruePeak[l][c] > pfMeterPeak[l][c] ? pfMeterTruePeak[l][c] : pfMeterPeak[l][c];
+                        frame.pfMeanSquare[c] = pfMeterSquares[l][c] / iItems;
+                        frame.pfGain[c] = pfKeyBlock[l][iDone - 1];
+                        pfMeterPeak[l][c] = pfMeterTruePeak[l][c] = pfMeterSquares[l][c] = 0;
+                    }
+                    telemetry[l].push(frame);
+                    iItems = 0;
+                }
+            }
+        }
+        iMeasuredItems = iItems;
+    }
+
+    // scratch for one internal block
+    alignas(64) float pfLaneBlock[kBlockSize][Lanes]; // sample-major, one vector of lanes per sample
+    alignas(32) float pfKeyBlock[Lanes][kBlockSize];  // instance-major: key, then peak, then gain
+    alignas(32) float pfDryBlock[kBlockSize];
+    alignas(32) float ppfTruePeakBlock[2][kBlockSize]; // one instance's oversampled output peaks
+    OutputScratch scratch;
+
+    // per-instance state, one entry per lane
+    Settings settings[Lanes];
+    bool pbSettingsChanged[Lanes];
+    OutputGains gains[Lanes];
+    SidechainFilter sidechain[Lanes]; // coefficients only, the filter state is pfZ1 / pfZ2
+    GateLevels gate[Lanes];
+    PeakDetector detector[Lanes];
+    MultiTapDelay echo[Lanes][2];
+    DelayLine lookahead[Lanes][2];
+    alignas(64) float pfZ1[Lanes], pfZ2[Lanes];
+    alignas(64) float pfEnvelopeState[Lanes], pfHoldState[Lanes];
+    int piStage[Lanes];
+    TruePeak meterTruePeak[Lanes][2];
+    float pfMeterPeak[Lanes][2], pfMeterTruePeak[Lanes][2], pfMeterSquares[Lanes][2];
+    MeterRing<2> telemetry[Lanes];
+    StageProfiler profiler;
+    int piLookahead[Lanes];
+
+    // shared by every instance (they all run at the same rate and block size)
+    float fSampleRate;
+    int iMeasuredLength, iMeasuredItems;
+    float fMaxDelayTime;             // ms the echo lines are sized for, and how they store samples
+    MultiTapDelay::Storage delayStorage;
+    int iGridPhase;                  // samples into the current grid block
+};
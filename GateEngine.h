@@ -0,0 +1,1129 @@
+//
+//  GateEngine.h
+//  MyEffect Gate Engine
+//
+//  The gate, meters and feedback delay for a bus of Channels channels, templated on the
+//  channel count so every per-channel loop has a fixed trip count. State is laid out as a
+//  structure of arrays: each piece of state is an array with one entry per channel, and each
+//  stage runs over whole internal blocks of one channel at a time.
+//
+//  The gate can be linked (one detector keyed from the mean of all channels, one gain applied
+//  to every channel, so the image does not shift) or unlinked (every channel keys and gates
+//  itself). It can also gate band by band ("Multiband", see SpectralGate.h) in place of the
+//  broadband gain. MyEffect runs the stereo instance; wider buses (5.1, 7.1, 16-track stems) use
+//  GateEngine<6>, <8> or <16> directly.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include "SimdKernels.h"
+#include "SidechainFilter.h"
+#include "GateEnvelope.h"
+#include "SpectralGate.h"
+#include "TruePeak.h"
+#include "PcmKernels.h"
+#include "FastMath.h"
+#include "PeakDetector.h"
+#include "DelayLine.h"
+#include "MultiTapDelay.h"
+#include "MeterTelemetry.h"
+#include "SmoothedValue.h"
+#include "DenormalGuard.h"
+#include "StageProfiler.h"
+
+// everything that does not depend on the channel count
+struct GateEngineBase
+{
+    static constexpr float kMaxDetectorWindow = 10; // ms, top of the "Detector (ms)" control
+    static constexpr float kMaxLookahead = 20;      // ms, top of the "Lookahead (ms)" control
+    static constexpr float kMinDelayTime = 10;      // ms, range of the "Delay Time (ms)" control
+    static constexpr float kMaxDelayTime = 1000;    // (the echo lines are sized for this unless setDelayOptions() says otherwise)
+    static constexpr float kDelayGlideTime = 50;    // ms taken to glide to a new delay time
+    static constexpr float kMaxSampleRate = 192000; // detector and lookahead are sized for at least this rate
+    static constexpr float kGainGlideTime = 20;     // ms taken by the dry / wet / feedback gains to follow their controls
+    static constexpr float kSilence = 1e-8f;        // -160 dBFS: audio below this counts as silence
+
+    static const int kBlockSize = 256; // longest internal block, host blocks are split into these
+
+    enum Link { LINKED, UNLINKED }; // same order as the "Channel Link" menu
+    enum Bands { BROADBAND, MULTIBAND }; // same order as the "Gate Bands" menu
+
+    static const int kMaxTaps = MultiTapDelay::kMaxTaps;
+
+    // an echo tap beyond the first: its time, and its output level and feedback send relative
+    // to the first tap's (which is the "Delay Time (ms)" control, at 1 and 1)
+    struct DelayTap {
+        float fTime;         // ms
+        float fLevel, fSend; // 0..1
+    };
+
+    // control values, as they come from the plugin parameters
+    struct Settings {
+        float fThreshDb, fHystDb, fReductionDb;
+        float fAttack, fHold, fRelease;             // ms
+        SidechainFilter::Type filterType;
+        float fLowPass, fHighPass, fCentre, fWidth; // Hz
+        float fDetector, fLookahead;                // ms
+        float fFeedback, fDelayTime;                // 0..1, ms
+        float fWetPercent, fDryPercent;
+        Link link;
+        Bands bands;                                // multiband ignores the filter, detector and lookahead
+        int iExtraTaps = 0;                         // echo taps read besides the first (none from the plugin controls)
+        DelayTap extraTaps[kMaxTaps - 1] = {};
+    };
+
+protected:
+    // the gate levels and ballistics one detector works with, worked out from the Settings
+    struct GateLevels {
+        float fThreshDb, fHystDb, fReductionDb;    // control values the levels below were worked out from
+        float fAttackMs, fHoldMs, fReleaseMs, fRate; // and the times and rate the ballistics were
+        float fOpenLevel, fCloseLevel, fFloorGain; // linear: open above, close below (threshold - hysteresis), gain when closed
+        float fAttack, fRelease;                   // one-pole coefficients per sample (see GateEnvelope.h)
+        float fHoldLength;                         // samples
+
+        // forces everything to be worked out on the first block
+        GateLevels() { fThreshDb = fHystDb = fReductionDb = fAttackMs = fHoldMs = fReleaseMs = fRate = NAN; }
+
+        void update(const Settings& settings, float fSampleRate);
+
+        // fPosition of the way from one set of levels to another (for morphing between presets)
+        static GateLevels mix(const GateLevels& from, const GateLevels& to, float fPosition)
+        {
+            GateLevels levels; // the control values are left unknown, so the next update() works everything out
+            levels.fOpenLevel = from.fOpenLevel + (to.fOpenLevel - from.fOpenLevel) * fPosition;
+            levels.fCloseLevel = from.fCloseLevel + (to.fCloseLevel - from.fCloseLevel) * fPosition;
+            levels.fAttack = from.fAttack + (to.fAttack - from.fAttack) * fPosition;
+            levels.fRelease = from.fRelease + (to.fRelease - from.fRelease) * fPosition;
+            levels.fHoldLength = from.fHoldLength + (to.fHoldLength - from.fHoldLength) * fPosition;
+            levels.fFloorGain = from.fFloorGain + (to.fFloorGain - from.fFloorGain) * fPosition;
+            return levels;
+        }
+    };
+
+    // lengths in samples that follow from the settings (multiband holds the audio back by the
+    // spectral gate's latency, for the echo to stay in step with the gated signal)
+    static int lookaheadSamples(const Settings& settings, float fSampleRate)
+    {
+        if (settings.bands == MULTIBAND)
+            return SpectralGateBase::latencySamples(fSampleRate);
+        return 0.001 * settings.fLookahead * fSampleRate;
+    }
+    static int detectorSamples(const Settings& settings, float fSampleRate) { return 0.001 * settings.fDetector * fSampleRate; }
+    static float delaySamples(float fTime, float fSampleRate)
+    {
+        //no lower than the bottom of the control
+        float fDelayTime = (fTime > kMinDelayTime ? fTime : kMinDelayTime) / 1000; // converts to ms
+        return fDelayTime * fSampleRate;
+    }
+
+    // every echo tap's delay in samples, the Delay Time control's first
+    static void tapSamples(const Settings& settings, float fSampleRate, float *pfSamples)
+    {
+        pfSamples[0] = delaySamples(settings.fDelayTime, fSampleRate);
+        for (int t = 0; t < settings.iExtraTaps; t++)
+            pfSamples[t + 1] = delaySamples(settings.extraTaps[t].fTime, fSampleRate);
+    }
+
+    // points an echo line's taps at these delays (gliding over iGlide samples)
+    static void setTaps(MultiTapDelay& line, const Settings& settings, const float *pfSamples, int iGlide)
+    {
+        line.setTapCount(1 + settings.iExtraTaps);
+        line.setTap(0, pfSamples[0], 1, 1, iGlide);
+        for (int t = 0; t < settings.iExtraTaps; t++)
+            line.setTap(t + 1, pfSamples[t + 1], settings.extraTaps[t].fLevel, settings.extraTaps[t].fSend, iGlide);
+    }
+
+public:
+    // Everything the engine works out from a set of control values at one sample rate: the gate
+    // levels and steps, the sidechain filter design and the line lengths. Made by compile() ahead
+    // of time (a preset), it can be put in place by loadProgram() at a block boundary with
+    // nothing left to calculate.
+    struct Program {
+        Settings settings;
+        float fSampleRate;
+        GateLevels gate;
+        SidechainFilter filter; // designed; only its coefficients and settings are used
+        float pfTapSamples[kMaxTaps];
+        int iLookahead, iDetectorLength;
+    };
+
+    static Program compile(const Settings& settings, float fSampleRate)
+    {
+        Program program;
+        program.settings = settings;
+        program.fSampleRate = fSampleRate;
+        program.gate.update(settings, fSampleRate);
+
+        program.filter.setType(settings.filterType);
+        program.filter.setSampleRate(fSampleRate);
+        program.filter.setLowPass(settings.fLowPass);
+        program.filter.setHighPass(settings.fHighPass);
+        program.filter.setBandPass(settings.fCentre, settings.fWidth);
+        program.filter.update();
+
+        tapSamples(settings, fSampleRate, program.pfTapSamples);
+        program.iLookahead = lookaheadSamples(settings, fSampleRate);
+        program.iDetectorLength = detectorSamples(settings, fSampleRate);
+        return program;
+    }
+
+protected:
+    // dry, wet and feedback gains for one internal block: constant, or per sample while gliding
+    struct BlockGains {
+        float fDry, fWet, fFeedback;
+        const float *pfDry, *pfWet, *pfFeedback; // nullptr when that gain is not moving
+    };
+
+    // the output gains, glided to new control values rather than jumped, so moving them does not click
+    struct OutputGains {
+        SmoothedValue dry, wet, feedback;
+        alignas(32) float pfDry[kBlockSize], pfWet[kBlockSize], pfFeedback[kBlockSize];
+
+        OutputGains() : dry(SmoothedValue::LINEAR), wet(SmoothedValue::LINEAR), feedback(SmoothedValue::EXPONENTIAL) {}
+
+        void update(const Settings& settings, float fSampleRate) { glideTo(settings, kGainGlideTime * 0.001 * fSampleRate); }
+
+        // as update(), gliding over iGlide samples
+        void glideTo(const Settings& settings, int iGlide)
+        {
+            dry.setTime(iGlide);
+            wet.setTime(iGlide);
+            feedback.setTime(iGlide / 4); // time constant: within 1e-5 by the end of the glide time for any jump up to 1
+            dry.setTarget(settings.fDryPercent / 100);
+            wet.setTarget(settings.fWetPercent / 100);
+            feedback.setTarget(settings.fFeedback);
+        }
+
+        void reset()
+        {
+            dry.reset();
+            wet.reset();
+            feedback.reset();
+        }
+
+        // the gains for the next iCount samples (advances any glides)
+        BlockGains next(int iCount)
+        {
+            BlockGains gains = { dry.getValue(), wet.getValue(), feedback.getValue(), nullptr, nullptr, nullptr };
+            if (dry.isRamping()) { dry.process(pfDry, iCount); gains.pfDry = pfDry; }
+            if (wet.isRamping()) { wet.process(pfWet, iCount); gains.pfWet = pfWet; }
+            if (feedback.isRamping()) { feedback.process(pfFeedback, iCount); gains.pfFeedback = pfFeedback; }
+            return gains;
+        }
+    };
+
+    // scratch buffers for outputBlock(), one internal block each
+    struct OutputScratch {
+        alignas(32) float pfGated[kBlockSize];
+        alignas(32) float pfDelay[kBlockSize];
+        alignas(32) float pfFeedback[kBlockSize];
+        alignas(32) float pfSend[kBlockSize];
+    };
+
+    // The variants of the audio path. The engines pick one of each for every internal block from
+    // the settings in force, and run the outputBlock() compiled for that pair, so the sample loops
+    // never test for a feature that is switched off. (The filter type needs no variant: all three
+    // are the same biquad with different coefficients.)
+    enum GateMode {
+        GATE_ACTIVE,   // the gain follows the detector
+        GATE_BYPASSED, // "Reduction (dB)" at 0 and the gain already at 1: it can only stay at 1
+        GATE_SPECTRAL, // multiband: the spectral gate has already gated the audio band by band
+        NUM_GATE_MODES
+    };
+    enum EchoMode {
+        ECHO_ACTIVE,   // the echo is heard (what comes out of the line is scaled by the feedback)
+        ECHO_SILENT,   // no feedback, so nothing is heard from the line, which is only kept filled
+        NUM_ECHO_MODES
+    };
+
+    // the echo variant for a block with these gains (a delay time glide needs reads to advance, so it stays active)
+    static EchoMode echoMode(const BlockGains& gains, const MultiTapDelay& line)
+    {
+        if (gains.pfFeedback || gains.fFeedback != 0 || line.isRamping())
+            return ECHO_ACTIVE;
+        return ECHO_SILENT;
+    }
+
+    typedef void (*OutputKernel)(const float *pfDry, const float *pfGain, MultiTapDelay& echo, const BlockGains& gains,
+                                 float *pfOut, int iCount, OutputScratch& scratch, StageProfiler& profiler);
+
+    // the outputBlock() for a pair of variants, from a table built at compile time
+    static OutputKernel outputKernel(GateMode gateMode, EchoMode echoMode)
+    {
+        static const OutputKernel kernels[NUM_GATE_MODES][NUM_ECHO_MODES] = {
+            { &outputBlock<GATE_ACTIVE, ECHO_ACTIVE>, &outputBlock<GATE_ACTIVE, ECHO_SILENT> },
+            { &outputBlock<GATE_BYPASSED, ECHO_ACTIVE>, &outputBlock<GATE_BYPASSED, ECHO_SILENT> },
+            { &outputBlock<GATE_SPECTRAL, ECHO_ACTIVE>, &outputBlock<GATE_SPECTRAL, ECHO_SILENT> },
+        };
+        return kernels[gateMode][echoMode];
+    }
+
+    // The audio path of one channel for one internal block: the dry signal times the gate gain
+    // (pfGain is not read when the gate is bypassed), plus the echo, into pfOut. pfOut may be pfDry.
+    // For the spectral gate pfGain is the gated audio itself, and pfDry only feeds the echo.
+    template <GateMode Gate, EchoMode Echo>
+    static void outputBlock(const float *pfDry, const float *pfGain, MultiTapDelay& echo, const BlockGains& gains,
+                            float *pfOut, int iCount, OutputScratch& scratch, StageProfiler& profiler)
+    {
+        {
+            PROFILE_STAGE(profiler, DELAY);
+            echoBlock<Echo>(echo, pfDry, scratch.pfDelay, iCount, gains, scratch.pfSend, scratch.pfFeedback);
+        }
+        PROFILE_STAGE(profiler, MIX);
+
+        //creates an output for the gate using the multiplier and the gain (straight into the output with no echo to add)
+        float *pfGated = Echo == ECHO_SILENT ? pfOut : scratch.pfGated;
+        if (Gate == GATE_BYPASSED || Gate == GATE_SPECTRAL) {
+            const float *pfSource = Gate == GATE_SPECTRAL ? pfGain : pfDry;
+            if (gains.pfDry)
+                simd::multiply(pfSource, gains.pfDry, pfGated, iCount);
+            else
+                simd::scale(pfSource, gains.fDry, pfGated, iCount);
+        }
+        else if (gains.pfDry) {
+            simd::multiply(pfDry, pfGain, pfGated, iCount);
+            simd::multiply(pfGated, gains.pfDry, pfGated, iCount);
+        }
+        else
+            simd::applyGain(pfDry, pfGain, gains.fDry, pfGated, iCount);
+
+        if (Echo == ECHO_SILENT)
+            return;
+
+        //mixes the delay signal and the gate signal
+        if (gains.pfWet)
+            simd::multiplyAdd(pfGated, scratch.pfDelay, gains.pfWet, pfOut, iCount);
+        else
+            simd::mixOutput(pfGated, scratch.pfDelay, gains.fWet, pfOut, iCount);
+    }
+
+    // Feedback delay: reads the delayed signal (every tap, scaled by the feedback amount) into
+    // pfDelayOut and writes the dry signal plus the taps' feedback sends back into the echo line.
+    // Each pass is as long as the delay allows (the whole block unless the shortest tap is
+    // shorter than it), so the line reads and writes in contiguous runs rather than a sample at a
+    // time. pfSend and pfScratch hold one block each.
+    // Silent, the line is not read at all and just the dry signal goes back in, as it would with a
+    // feedback of 0. Samples that would go in below kSilence go in as zeros, so a tail dies away to
+    // silence instead of decaying into denormals, and the line knows to the sample when it is empty.
+    template <EchoMode Echo>
+    static void echoBlock(MultiTapDelay& line, const float *pfDry, float *pfDelayOut, int iCount, const BlockGains& gains,
+                          float *pfSend, float *pfScratch)
+    {
+        if (Echo == ECHO_SILENT) {
+            simd::scale(pfDry, 0.5f, pfScratch, iCount);
+            writeEcho(line, pfScratch, iCount);
+            return;
+        }
+
+        const float *pfFeedback = gains.pfFeedback;
+
+        while(iCount > 0)
+        {
+            int iRun = line.maxReadBlock();
+            if (iRun > iCount) iRun = iCount;
+
+            //reads the buffer output (the send is the output itself unless a tap sends a different amount)
+            const float *pfTapSend = line.read(pfDelayOut, pfSend, iRun);
+            bool bSeparateSend = pfTapSend != pfDelayOut;
+
+            //multiplies the buffer output by the delay feedback value
+            if (pfFeedback) {
+                simd::multiply(pfDelayOut, pfFeedback, pfDelayOut, iRun);
+                if (bSeparateSend)
+                    simd::multiply(pfSend, pfFeedback, pfSend, iRun);
+                pfFeedback += iRun;
+            }
+            else {
+                simd::scale(pfDelayOut, gains.fFeedback, pfDelayOut, iRun);
+                if (bSeparateSend)
+                    simd::scale(pfSend, gains.fFeedback, pfSend, iRun);
+            }
+
+            simd::average(pfDry, pfTapSend, pfScratch, iRun); // copys the delay back into itself
+
+            writeEcho(line, pfScratch, iRun);
+
+            pfDry += iRun;
+            pfDelayOut += iRun;
+            iCount -= iRun;
+        }
+    }
+
+    // a run into the echo line, with every sample below kSilence as zero (so it is the same
+    // however the block is split into runs)
+    static void writeEcho(MultiTapDelay& line, float *pfIn, int iCount)
+    {
+        if (simd::absMax(pfIn, iCount, 0) < kSilence) {
+            line.writeSilence(iCount);
+            return;
+        }
+        simd::zeroBelow(pfIn, kSilence, pfIn, iCount);
+        line.write(pfIn, iCount);
+    }
+};
+
+// Converts threshold, hysteresis and reduction from dB to linear levels, so the detector can
+// compare raw sidechain peaks without taking a log of every sample, and the times to envelope
+// coefficients and a hold length. Only does the maths when one of the controls (or the rate)
+// has actually moved.
+inline void GateEngineBase::GateLevels::update(const Settings& settings, float fSampleRate)
+{
+    float fThresh(settings.fThreshDb);
+    float fGateHyst(settings.fHystDb);
+    float fReductionAmount(settings.fReductionDb);
+
+    if (fThresh != fThreshDb || fGateHyst != fHystDb){
+        fThreshDb = fThresh;
+        fHystDb = fGateHyst;
+        fOpenLevel = fastmath::dbToGain(fThresh);
+        fCloseLevel = fastmath::dbToGain(fThresh - fabs(fGateHyst)); //the level must fall below the threshold - the hysteresis for the gate to close
+    }
+
+    if (fReductionAmount != fReductionDb){
+        fReductionDb = fReductionAmount;
+        fFloorGain = (fReductionAmount <= -100) ? 0 : fastmath::dbToGain(fReductionAmount); //the bottom of the range mutes completely
+        if (fReductionAmount >= 0) fFloorGain = 1; //exactly, so a gate with no reduction can be bypassed
+    }
+
+    if (settings.fAttack != fAttackMs || settings.fHold != fHoldMs || settings.fRelease != fReleaseMs || fSampleRate != fRate){
+        fAttackMs = settings.fAttack;
+        fHoldMs = settings.fHold;
+        fReleaseMs = settings.fRelease;
+        fRate = fSampleRate;
+        fAttack = GateEnvelope::coefficient(fAttackMs, fSampleRate);
+        fRelease = GateEnvelope::coefficient(fReleaseMs, fSampleRate);
+        fHoldLength = roundf(0.001f * (fHoldMs > 0 ? fHoldMs : 0) * fSampleRate);
+    }
+}
+
+template <int Channels>
+class GateEngine : public GateEngineBase
+{
+    static_assert(Channels >= 1, "a gate needs at least one channel");
+
+public:
+    static const int kChannels = Channels;
+
+    GateEngine()
+    : bSettingsChanged(false), pMorphTarget(nullptr), iMorphLength(0), iMorphLeft(0), gateMode(GATE_ACTIVE), fSampleRate(0), link(LINKED), iMeasuredLength(0), iMeasuredItems(0), iLookahead(0),
+      fMaxDelayTime(kMaxDelayTime), delayStorage(MultiTapDelay::FLOAT32), pPendingProgram(nullptr), iPendingMorph(0),
+      fHostRate(0), iGridPhase(0)
+    {
+        for (int c = 0; c < Channels; c++) {
+            sidechain[c].setRampLength(kBlockSize);
+            pfEnvelopeState[c] = pfHoldState[c] = 0;
+            piStage[c] = GateEnvelope::CLOSED;
+            pfMeterPeak[c] = pfMeterTruePeak[c] = pfMeterSquares[c] = 0;
+            pfMeterLevel[c] = 0;
+            piQuiet[c] = 0;
+            pbIdle[c] = pbKeyIdle[c] = false;
+        }
+    }
+
+    // Sizes every buffer for this sample rate and starts again from silence (allocates: not for
+    // the audio thread, nor while process() may be running). Every buffer process() uses is
+    // sized here or fixed at the internal block size, so no host block length needs to be known,
+    // and process() never allocates. The settings are worked out for the new rate at the next process().
+    void prepare(float fRate)
+    {
+        fSampleRate = fRate;
+        float fMaxRate = fRate > kMaxSampleRate ? fRate : kMaxSampleRate;
+        for (int c = 0; c < Channels; c++) {
+            echo[c].setMaxDelay(0.001 * fMaxDelayTime * fRate, kBlockSize, delayStorage); //room for the longest delay time at this sample rate
+            detector[c].setMaxLength(0.001 * kMaxDetectorWindow * fMaxRate);      //room for the longest detector window and lookahead at up to 192 kHz
+            lookahead[c].setMaxDelay(0.001 * kMaxLookahead * fMaxRate, kBlockSize);
+        }
+        spectral.prepare(fRate);
+        bSettingsChanged = true;
+        pPendingProgram = nullptr; //worked out again from its settings at the new rate
+        reset();
+    }
+
+    // How the echo lines are sized from the next prepare(): for delays up to fMaxMs (longer taps
+    // are held at it), with samples stored as floats or, for half the memory, as halves (see
+    // MultiTapDelay.h). The default is the top of the "Delay Time (ms)" control, as floats.
+    void setDelayOptions(float fMaxMs, MultiTapDelay::Storage storage)
+    {
+        fMaxDelayTime = fMaxMs > kMinDelayTime ? fMaxMs : kMinDelayTime;
+        delayStorage = storage;
+    }
+
+    // memory taken by the echo lines, in bytes
+    size_t getDelayBytes() const
+    {
+        size_t uBytes = 0;
+        for (int c = 0; c < Channels; c++)
+            uBytes += echo[c].getBufferBytes();
+        return uBytes;
+    }
+
+    // back to silence with the same settings, e.g. when the transport stops: clears the lines,
+    // filters, detectors, envelopes and meters, ends any glide or morph, and starts the block
+    // grid again from the next sample (no allocation)
+    void reset()
+    {
+        if (pPendingProgram)
+            applyProgram();
+        if (iMorphLeft > 0)
+            finishMorph();
+        gains.reset();
+        setGateMode(GATE_ACTIVE);
+        spectral.reset();
+
+        for (int c = 0; c < Channels; c++) {
+            echo[c].reset();
+            lookahead[c].reset();
+            sidechain[c].reset();
+            detector[c].reset();
+            pfEnvelopeState[c] = pfHoldState[c] = 0;
+            piStage[c] = GateEnvelope::CLOSED;
+            meterTruePeak[c].reset();
+            pfMeterPeak[c] = pfMeterTruePeak[c] = pfMeterSquares[c] = 0;
+            pfMeterLevel[c] = 0;
+            piQuiet[c] = 0;
+            pbIdle[c] = pbKeyIdle[c] = false;
+        }
+        iMeasuredItems = 0;
+        iGridPhase = 0;
+        dither.reset();
+    }
+
+    // latency added by the lookahead, for the host to compensate (changes with "Lookahead (ms)")
+    int getLatencySamples() const { return iLookahead; }
+
+    // raw meter readings, one frame per 1 ms of audio, for a MeterDisplay on another thread
+    MeterRing<Channels>& getTelemetry() { return telemetry; }
+
+    // the level a channel's meter control shows (0..1), as of the end of the last block
+    float getMeterLevel(int iChannel) const { return pfMeterLevel[iChannel]; }
+
+    // time spent in each stage of process(), readable from any thread (only filled in when
+    // built with MYEFFECT_PROFILE)
+    StageProfiler& getProfile() { return profiler; }
+
+    // new control values, picked up at the start of the next internal block on the grid (see
+    // process()); only call this when something has changed, as the derived values are all
+    // worked out again
+    void setSettings(const Settings& newSettings)
+    {
+        settings = newSettings;
+        bSettingsChanged = true;
+        pPendingProgram = nullptr;
+    }
+
+    // Puts a compiled program in place at the start of the next internal block, straight away or,
+    // with iMorphSamples > 0, gliding there over that many samples: gate levels and filter
+    // coefficients step across each block, and the gains and delay time glide. Lookahead, detector
+    // length and channel link cannot glide, and change at once. The program must outlive the
+    // morph (and be there until the block starts). One compiled for a different rate is worked
+    // out again, as setSettings().
+    void loadProgram(const Program& program, int iMorphSamples = 0)
+    {
+        if (program.fSampleRate != fSampleRate) {
+            setSettings(program.settings);
+            return;
+        }
+        settings = program.settings;
+        bSettingsChanged = false;
+        pPendingProgram = &program;
+        iPendingMorph = iMorphSamples;
+    }
+
+    // ppIn / ppOut hold Channels buffers of iCount samples (an output may be the same buffer as its input)
+    //
+    // However the host splits the audio, it runs in internal blocks on a fixed grid of kBlockSize
+    // samples counted from prepare() (or reset()): a call that ends part way through a grid block
+    // leaves the rest of it for the next call. Everything that is decided a block at a time - new
+    // settings or programs, morph steps, the gate variant, which channels rest - is decided at the
+    // start of a grid block, and the rest runs sample by sample, so the output and the telemetry
+    // are the same for any host block size, odd ones included, and the cost per sample is flat.
+    void process(const float* const* ppIn, float* const* ppOut, int iCount, float fRate)
+    {
+        DenormalGuard denormals;
+        PROFILE_BEGIN(profiler);
+        fHostRate = fRate;
+
+        const float *ppInBlock[Channels];
+        float *ppOutBlock[Channels];
+        for (int c = 0; c < Channels; c++) {
+            ppInBlock[c] = ppIn[c];
+            ppOutBlock[c] = ppOut[c];
+        }
+        for (int iDone = 0; iDone < iCount; )
+        {
+            int iBlock = kBlockSize - iGridPhase < iCount - iDone ? kBlockSize - iGridPhase : iCount - iDone;
+            iBlock = processBlock(ppInBlock, ppOutBlock, iBlock);
+
+            for (int c = 0; c < Channels; c++) {
+                ppInBlock[c] += iBlock;
+                ppOutBlock[c] += iBlock;
+            }
+            iDone += iBlock;
+        }
+        PROFILE_END(profiler, iCount, fSampleRate);
+    }
+
+    // The same from interleaved integer PCM (iFrames frames of Channels samples) to interleaved
+    // integer PCM, e.g. straight from a capture buffer to a playout buffer. Each internal block is
+    // read into float scratch, processed there and written back out, dithered, so no full-length
+    // float copy is ever made (see PcmKernels.h). pIn and pOut may be the same buffer if the formats match.
+    void processPcm(const void* pIn, pcm::Format inFormat, void* pOut, pcm::Format outFormat, int iFrames, float fRate)
+    {
+        DenormalGuard denormals;
+        PROFILE_BEGIN(profiler);
+        fHostRate = fRate;
+
+        const uint8_t *pRead = (const uint8_t*)pIn;
+        uint8_t *pWrite = (uint8_t*)pOut;
+        const int iInStride = Channels * pcm::bytesPerSample(inFormat), iOutStride = Channels * pcm::bytesPerSample(outFormat);
+        float *ppBlock[Channels];
+        for (int c = 0; c < Channels; c++)
+            ppBlock[c] = ppfPcmBlock[c];
+
+        for (int iFrame = 0; iFrame < iFrames; )
+        {
+            int iBlock = kBlockSize - iGridPhase < iFrames - iFrame ? kBlockSize - iGridPhase : iFrames - iFrame;
+            {
+                PROFILE_STAGE(profiler, CONVERT);
+                pcm::read(inFormat, pRead, Channels, ppBlock, iBlock);
+            }
+            for (int iDone = 0; iDone < iBlock; ) {
+                float *ppRun[Channels];
+                for (int c = 0; c < Channels; c++)
+                    ppRun[c] = ppBlock[c] + iDone;
+                iDone += processBlock(ppRun, ppRun, iBlock - iDone);
+            }
+            {
+                PROFILE_STAGE(profiler, CONVERT);
+                pcm::write(ppBlock, Channels, outFormat, pWrite, iBlock, &dither);
+            }
+
+            pRead += iBlock * iInStride;
+            pWrite += iBlock * iOutStride;
+            iFrame += iBlock;
+        }
+        PROFILE_END(profiler, iFrames, fSampleRate);
+    }
+
+private:
+    // puts the program from loadProgram() in place
+    void applyProgram()
+    {
+        const Program& program = *pPendingProgram;
+        int iMorphSamples = iPendingMorph;
+        pPendingProgram = nullptr;
+        iMorphLeft = 0;
+
+        setLink(settings.link);
+        setLookahead(program.iLookahead);
+
+        int iGlide = iMorphSamples > 0 ? iMorphSamples : kGainGlideTime * 0.001 * fSampleRate;
+        int iDelayGlide = iMorphSamples > 0 ? iMorphSamples : kDelayGlideTime * 0.001 * fSampleRate;
+        gains.glideTo(settings, iGlide);
+        for (int c = 0; c < Channels; c++) {
+            detector[c].setLength(program.iDetectorLength);
+            setTaps(echo[c], settings, program.pfTapSamples, iDelayGlide);
+        }
+
+        if (iMorphSamples > 0) {
+            sidechain[0].update();
+            morphGate = gate;
+            morphFilter = sidechain[0].getCoefficients();
+            pMorphTarget = &program;
+            iMorphLength = iMorphLeft = iMorphSamples;
+            return;
+        }
+        gate = program.gate;
+        for (int c = 0; c < Channels; c++)
+            sidechain[c].load(program.filter);
+    }
+
+    // One run of at most kBlockSize samples inside a grid block, the whole pipeline from the key to
+    // the mix. At the start of a grid block, beginBlock() takes the decisions for it. A resting
+    // channel wakes on the first sample of its input above silence, so the run stops short there
+    // (and the rest of the grid block goes on from it); returns the samples it did.
+    int processBlock(const float* const* ppInBlock, float* const* ppOutBlock, int iBlock)
+    {
+        if (iGridPhase == 0)
+            beginBlock();
+        iBlock = wake(ppInBlock, iBlock);
+
+        //silent samples in a row, to the sample, for the next grid block's decisions (counted before
+        //the output, which may be the same buffer, is written)
+        for (int c = 0; c < Channels; c++) {
+            int iLoud = simd::lastReaching(ppInBlock[c], iBlock, kSilence);
+            piQuiet[c] = iLoud >= 0 ? iBlock - 1 - iLoud : (piQuiet[c] < (1 << 30) ? piQuiet[c] + iBlock : piQuiet[c]);
+        }
+
+        if (gateMode == GATE_ACTIVE)
+            keyBlock(ppInBlock, iBlock);
+        else if (gateMode == GATE_SPECTRAL)
+            spectralBlock(ppInBlock, pbIdle[0], iBlock);
+
+        BlockGains blockGains = gains.next(iBlock);
+        OutputKernel kernel = outputKernel(gateMode, echoMode(blockGains, echo[0]));
+
+        for (int c = 0; c < Channels; c++) {
+            //silent in, and nothing left in the lookahead or the echo: silent out, whatever the gain
+            if (pbIdle[c]) {
+                PROFILE_STAGE(profiler, MIX);
+                simd::fill(ppOutBlock[c], 0, iBlock);
+                continue;
+            }
+
+            const float *pfGain = gateMode == GATE_SPECTRAL ? ppfBandBlock[c] : pfGainBlock[link == LINKED ? 0 : c];
+
+            //from here on the audio path runs iLookahead samples behind the detector
+            const float *pfDry = ppInBlock[c];
+            if (iLookahead > 0) {
+                PROFILE_STAGE(profiler, DELAY);
+                lookahead[c].process(pfDry, pfDryBlock, iBlock);
+                pfDry = pfDryBlock;
+            }
+
+            kernel(pfDry, pfGain, echo[c], blockGains, ppOutBlock[c], iBlock, scratch, profiler);
+        }
+        meterBlock(ppOutBlock, iBlock);
+
+        iGridPhase = iGridPhase + iBlock < kBlockSize ? iGridPhase + iBlock : 0;
+        return iBlock;
+    }
+
+    // The decisions for the grid block starting now: new settings or a program, the next step of
+    // a morph, the gate variant, and which channels and keys rest until their input wakes them.
+    // Each is made from what has already been played, never from samples a call has not yet
+    // been given, so it comes out the same however the audio is split.
+    void beginBlock()
+    {
+        if (pPendingProgram)
+            applyProgram();
+        else if (bSettingsChanged || fHostRate != fSampleRate)
+            applySettings(fHostRate);
+        if (iMorphLeft > 0)
+            morphBlock(kBlockSize);
+
+        if (settings.bands == MULTIBAND)
+            setGateMode(GATE_SPECTRAL);
+        else
+            setGateMode(gateBypassed() ? GATE_BYPASSED : GATE_ACTIVE);
+
+        //silent in for long enough to have flushed the lookahead (or spectral frames), and nothing
+        //left in the echo: the channel rests, silent out, until its input wakes it
+        int iFlush = settings.bands == MULTIBAND ? 2 * iLookahead : iLookahead;
+        bool bAllIdle = true;
+        for (int c = 0; c < Channels; c++) {
+            pbIdle[c] = piQuiet[c] >= iFlush && echo[c].isSilent();
+            bAllIdle = bAllIdle && pbIdle[c];
+        }
+
+        //the spectral gate runs every channel in step, so it only rests when they all can
+        if (gateMode == GATE_SPECTRAL)
+            for (int c = 0; c < Channels; c++)
+                pbIdle[c] = bAllIdle;
+
+        //a closed gate whose key has been silent for a whole block parks its sidechain
+        if (gateMode == GATE_ACTIVE) {
+            if (link == UNLINKED || Channels == 1) {
+                for (int c = 0; c < Channels; c++)
+                    keyIdle(c, piQuiet[c] >= kBlockSize);
+            }
+            else {
+                bool bQuiet = true;
+                for (int c = 0; c < Channels; c++)
+                    bQuiet = bQuiet && piQuiet[c] >= kBlockSize;
+                keyIdle(0, bQuiet);
+            }
+        }
+    }
+
+    // true while the key of channel c's gate is parked
+    bool keyResting(int c) const { return gateMode == GATE_ACTIVE && pbKeyIdle[link == UNLINKED ? c : 0]; }
+
+    // Wakes every resting channel (and parked key) whose input goes above silence on the run's
+    // first sample, and shortens the run to end where the next one would, so it wakes on that
+    // sample. Returns the run's length.
+    int wake(const float* const* ppIn, int iBlock)
+    {
+        int piLoud[Channels];
+        for (int c = 0; c < Channels; c++)
+            piLoud[c] = pbIdle[c] || keyResting(c) ? simd::firstReaching(ppIn[c], iBlock, kSilence) : iBlock;
+
+        for (int c = 0; c < Channels; c++) {
+            if (piLoud[c] > 0)
+                continue;
+            pbIdle[c] = false;
+            if (gateMode == GATE_SPECTRAL)
+                for (int d = 0; d < Channels; d++)
+                    pbIdle[d] = false;
+            pbKeyIdle[link == UNLINKED ? c : 0] = false;
+        }
+
+        int iRun = iBlock;
+        for (int c = 0; c < Channels; c++)
+            if ((pbIdle[c] || keyResting(c)) && piLoud[c] < iRun)
+                iRun = piLoud[c];
+        return iRun;
+    }
+
+    // works out everything that follows from the control values (only when they or the rate change)
+    void applySettings(float fRate)
+    {
+        bSettingsChanged = false;
+        iMorphLeft = 0; //a control moved (or the rate changed) during a morph: the controls win
+        fSampleRate = fRate;
+        iMeasuredLength = (0.001 * fSampleRate);
+
+        setLink(settings.link);
+
+        gate.update(settings, fSampleRate);
+        gains.update(settings, fSampleRate);
+
+        //the audio is held back by the lookahead so the detector sees transients before they reach the gain
+        setLookahead(lookaheadSamples(settings, fSampleRate));
+
+        float pfTapSamples[kMaxTaps];
+        tapSamples(settings, fSampleRate, pfTapSamples);
+
+        for (int c = 0; c < Channels; c++) {
+            detector[c].setLength(detectorSamples(settings, fSampleRate));
+
+            //assigns parameters to the sidechain filter (coefficients are only redesigned if one of these moved)
+            sidechain[c].setType(settings.filterType);
+            sidechain[c].setSampleRate(fSampleRate);
+            sidechain[c].setLowPass(settings.fLowPass);
+            sidechain[c].setHighPass(settings.fHighPass);
+            sidechain[c].setBandPass(settings.fCentre, settings.fWidth);
+
+            //for the delay, glides to a new delay time rather than jumping
+            setTaps(echo[c], settings, pfTapSamples, kDelayGlideTime * 0.001 * fSampleRate);
+        }
+    }
+
+    void setLink(Link newLink)
+    {
+        if (newLink == link)
+            return;
+
+        //carry on from the linked gain, and start the other channels' sidechains from silence
+        for (int c = 1; c < Channels; c++) {
+            pfEnvelopeState[c] = pfEnvelopeState[0];
+            pfHoldState[c] = pfHoldState[0];
+            piStage[c] = piStage[0];
+            sidechain[c].reset();
+            detector[c].reset();
+        }
+        for (int c = 0; c < Channels; c++)
+            pbKeyIdle[c] = false;
+        link = newLink;
+    }
+
+    void setLookahead(int iNewLookahead)
+    {
+        if (iNewLookahead > lookahead[0].getMaxDelay()) iNewLookahead = lookahead[0].getMaxDelay();
+
+        for (int c = 0; c < Channels; c++) {
+            if (iLookahead == 0 && iNewLookahead > 0)
+                lookahead[c].reset(); //the line is not kept up to date while lookahead is off, so start from silence
+            lookahead[c].setDelay(iNewLookahead);
+        }
+        iLookahead = iNewLookahead;
+    }
+
+    // one block's step of a morph: the gate levels and filter coefficients are set to where the
+    // morph will be at the end of the block (the filter ramps there across it), and the target
+    // program is put in place exactly at the end
+    void morphBlock(int iCount)
+    {
+        iMorphLeft = iMorphLeft > iCount ? iMorphLeft - iCount : 0;
+
+        if (iMorphLeft == 0) {
+            finishMorph();
+            return;
+        }
+
+        float fPosition = 1 - (float)iMorphLeft / iMorphLength;
+        const SidechainFilter::Coefficients& to = pMorphTarget->filter.getCoefficients();
+        SidechainFilter::Coefficients step(
+            morphFilter.b0 + (to.b0 - morphFilter.b0) * fPosition, morphFilter.b1 + (to.b1 - morphFilter.b1) * fPosition,
+            morphFilter.b2 + (to.b2 - morphFilter.b2) * fPosition, morphFilter.a1 + (to.a1 - morphFilter.a1) * fPosition,
+            morphFilter.a2 + (to.a2 - morphFilter.a2) * fPosition); //stays stable: the stable (a1, a2) region is convex
+
+        gate = GateLevels::mix(morphGate, pMorphTarget->gate, fPosition);
+        for (int c = 0; c < Channels; c++)
+            sidechain[c].rampTo(step);
+    }
+
+    void finishMorph()
+    {
+        iMorphLeft = 0;
+        gate = pMorphTarget->gate;
+        for (int c = 0; c < Channels; c++)
+            sidechain[c].load(pMorphTarget->filter);
+    }
+
+    // true when the gate can only pass the audio untouched: no reduction, and every envelope in use fully open
+    bool gateBypassed() const
+    {
+        if (gate.fFloorGain != 1)
+            return false;
+        for (int c = 0; c < (link == LINKED ? 1 : Channels); c++) {
+            if (pfEnvelopeState[c] != 1)
+                return false;
+        }
+        return true;
+    }
+
+    // While the gate is bypassed the sidechain is not run, and the gain blocks (which the meters
+    // read) hold 1. When it comes back, the sidechain starts again from silence, as does the
+    // spectral gate when multiband is picked.
+    void setGateMode(GateMode newMode)
+    {
+        if (newMode == gateMode)
+            return;
+        if (newMode == GATE_SPECTRAL)
+            spectral.reset();
+        for (int c = 0; c < Channels; c++) {
+            if (newMode == GATE_BYPASSED)
+                simd::fill(pfGainBlock[c], 1, kBlockSize);
+            else {
+                sidechain[c].reset();
+                detector[c].reset();
+            }
+            pbKeyIdle[c] = false;
+        }
+        gateMode = newMode;
+    }
+
+    // Sidechain: filters the key and runs the detector / gate envelope, leaving the gain for every
+    // sample in pfGainBlock[0] (linked) or pfGainBlock[c] for each channel (unlinked). A parked
+    // gate is left at its resting gain, its filter settled on its latest design.
+    void keyBlock(const float* const* ppIn, int iCount)
+    {
+        if (link == UNLINKED || Channels == 1) {
+            for (int c = 0; c < Channels; c++) {
+                if (pbKeyIdle[c]) {
+                    sidechain[c].settle();
+                    continue;
+                }
+                {
+                    PROFILE_STAGE(profiler, SIDECHAIN);
+                    sidechain[c].process(ppIn[c], pfKeyBlock, iCount);
+                }
+                detectBlock(c, pfKeyBlock, pfGainBlock[c], iCount);
+            }
+            return;
+        }
+
+        if (pbKeyIdle[0]) {
+            sidechain[0].settle();
+            return;
+        }
+
+        {
+            PROFILE_STAGE(profiler, SIDECHAIN);
+
+            //linked: the key is the mean of all the channels
+            simd::add(ppIn[0], ppIn[1], pfKeyBlock, iCount);
+            for (int c = 2; c < Channels; c++)
+                simd::add(pfKeyBlock, ppIn[c], pfKeyBlock, iCount);
+            simd::scale(pfKeyBlock, 1.0f / Channels, pfKeyBlock, iCount);
+
+            sidechain[0].process(pfKeyBlock, pfKeyBlock, iCount);
+        }
+        detectBlock(0, pfKeyBlock, pfGainBlock[0], iCount);
+    }
+
+    // Multiband: the spectral gate gates every channel into ppfBandBlock with the gate's levels
+    // and ballistics, and the gain blocks hold each channel's mean band gain for the meters.
+    // While every channel is idle it is not run at all: its frames hold nothing but silence.
+    void spectralBlock(const float* const* ppIn, bool bIdle, int iCount)
+    {
+        PROFILE_STAGE(profiler, GATE);
+        if (!bIdle) {
+            SpectralGateBase::Levels levels = {
+                gate.fOpenLevel, gate.fCloseLevel, gate.fFloorGain, gate.fAttack, gate.fRelease, gate.fHoldLength };
+
+            float *ppOutBlock[Channels];
+            for (int c = 0; c < Channels; c++)
+                ppOutBlock[c] = ppfBandBlock[c];
+            spectral.process(ppIn, ppOutBlock, iCount, levels, link == LINKED);
+        }
+        for (int c = 0; c < Channels; c++)
+            simd::fill(pfGainBlock[c], spectral.getGain(c, link == LINKED), iCount);
+    }
+
+    // Parks gate iGate for the grid block when its key has been silent for a whole block and it
+    // is closed with the hold run out, so nothing could move its gain until the key comes back.
+    // The sidechain is then not run, and starts again from silence; pfGainBlock[iGate] holds the
+    // resting gain meanwhile.
+    void keyIdle(int iGate, bool bQuiet)
+    {
+        bool bIdle = bQuiet && piStage[iGate] == GateEnvelope::CLOSED;
+        if (bIdle && !pbKeyIdle[iGate]) {
+            sidechain[iGate].reset();
+            detector[iGate].reset();
+        }
+        if (bIdle)
+            simd::fill(pfGainBlock[iGate], gate.fFloorGain, kBlockSize);
+        pbKeyIdle[iGate] = bIdle;
+    }
+
+    // Detector and gate envelope: runs the gate on every sample against the peak of the filtered
+    // sidechain over the last detector window, so it opens and closes on the sample a transient
+    // crosses the threshold rather than at the end of a fixed 1 ms window. pfGain receives the gain
+    // for each sample.
+    void detectBlock(int iChannel, const float *pfKey, float *pfGain, int iCount)
+    {
+        float fEnvelope = pfEnvelopeState[iChannel], fHold = pfHoldState[iChannel];
+        int iStage = piStage[iChannel];
+
+        //peak of the sidechain over the detector window, written into pfGain and then replaced by the gain
+        {
+            PROFILE_STAGE(profiler, DETECTOR);
+            detector[iChannel].process(pfKey, pfGain, iCount);
+        }
+        PROFILE_STAGE(profiler, GATE);
+
+        for(int i = 0; i < iCount; )
+        {
+            int iRun = (iCount - i) < 8 ? (iCount - i) : 8;
+
+            //steady states: fully open and staying open, or closed and not reopening
+            if (fEnvelope == 1 && simd::countAbove(pfGain + i, iRun, gate.fOpenLevel) == iRun){
+                simd::fill(pfGain + i, 1, iRun);
+                fHold = gate.fHoldLength;
+                iStage = GateEnvelope::OPEN;
+                i += iRun;
+                continue;
+            }
+            //fully open with the hold outlasting the run, however the key moves: also stays at 1
+            if (fEnvelope == 1 && fHold > iRun && gate.fHoldLength > iRun){
+                int iLast = -1;
+                for (int j = 0; j < iRun; j++)
+                    if (pfGain[i + j] > gate.fOpenLevel) iLast = j;
+                simd::fill(pfGain + i, 1, iRun);
+                fHold = iLast < 0 ? fHold - iRun : gate.fHoldLength - (iRun - 1 - iLast);
+                iStage = iLast == iRun - 1 ? GateEnvelope::OPEN : GateEnvelope::HOLD;
+                i += iRun;
+                continue;
+            }
+            if (iStage == GateEnvelope::CLOSED && simd::countAbove(pfGain + i, iRun, gate.fOpenLevel) == 0){
+                simd::fill(pfGain + i, gate.fFloorGain, iRun);
+                i += iRun;
+                continue;
+            }
+
+            for(int iEnd = i + iRun; i < iEnd; i++)
+            {
+                GateEnvelope::step(pfGain[i], gate.fOpenLevel, gate.fCloseLevel, gate.fAttack, gate.fRelease, gate.fHoldLength,
+                                   1, fEnvelope, fHold, iStage);
+                pfGain[i] = GateEnvelope::gain(gate.fFloorGain, fEnvelope);
+            }
+        }
+
+        pfEnvelopeState[iChannel] = fEnvelope;
+        pfHoldState[iChannel] = fHold;
+        piStage[iChannel] = iStage;
+    }
+
+    // Meters: finds the output's sample peak, true peak and sum of squares over each measuring
+    // window (iMeasuredLength samples) and, at the end of the window, sends them with the gate
+    // gain of each channel to the telemetry ring. The one bit of display work done here is the
+    // level of the meter controls, which only the audio thread may write (a fast log per channel
+    // per window); the rest of the scaling is left to the thread reading the ring.
+    void meterBlock(const float* const* ppOut, int iCount)
+    {
+        PROFILE_STAGE(profiler, METERS);
+
+        //the oversampled peak at every sample of the block, so each window only needs its largest
+        for (int c = 0; c < Channels; c++)
+            meterTruePeak[c].process(ppOut[c], ppfTruePeakBlock[c], iCount);
+
+        for (int iDone = 0; iDone < iCount; )
+        {
+            // run up to the end of the current window, or the end of the block
+            int iSegment = iMeasuredLength - iMeasuredItems;
+            if (iSegment < 1) iSegment = 1;
+            if (iSegment > iCount - iDone) iSegment = iCount - iDone;
+
+            //peak detction for the metering
+            for (int c = 0; c < Channels; c++) {
+                pfMeterPeak[c] = simd::absMax(ppOut[c] + iDone, iSegment, pfMeterPeak[c]);
+                pfMeterTruePeak[c] = simd::absMax(ppfTruePeakBlock[c] + iDone, iSegment, pfMeterTruePeak[c]);
+                pfMeterSquares[c] = simd::sumSquares(ppOut[c] + iDone, iSegment, pfMeterSquares[c]);
+            }
+
+            iMeasuredItems += iSegment; //steps through the measured items
+            iDone += iSegment;
+
+            if (iMeasuredItems >= iMeasuredLength){
+
+                MeterFrame<Channels> frame;
+                for (int c = 0; c < Channels; c++) {
+                    frame.pfPeak[c] = pfMeterPeak[c];
+                    frame.pfTruePeak[c] = pfMeterTruePeak[c] > pfMeterPeak[c] ? pfMeterTruePeak[c] : pfMeterPeak[c];
+                    frame.pfMeanSquare[c] = pfMeterSquares[c] / iMeasuredItems;
+                    frame.pfGain[c] = pfGainBlock[link == LINKED ? 0 : c][iDone - 1];
+                    pfMeterLevel[c] = MeterDisplay<Channels>::meterLevel(frame.pfTruePeak[c], pfMeterLevel[c]);
+                    pfMeterPeak[c] = pfMeterTruePeak[c] = pfMeterSquares[c] = 0;
+                }
+                telemetry.push(frame); //dropped if nobody is reading
+                iMeasuredItems = 0;
+            }
+        }
+    }
+
+    // scratch for one internal block
+    alignas(32) float pfKeyBlock[kBlockSize];
+    alignas(32) float pfGainBlock[Channels][kBlockSize];
+    alignas(32) float pfDryBlock[kBlockSize];
+    alignas(32) float ppfBandBlock[Channels][kBlockSize]; // the spectral gate's output
+    alignas(32) float ppfPcmBlock[Channels][kBlockSize];  // processPcm()'s block, converted from and back to PCM
+    alignas(32) float ppfTruePeakBlock[Channels][kBlockSize]; // the output's oversampled peak at each sample
+    OutputScratch scratch;
+
+    // per-channel state, one entry per channel (linked gating only uses entry 0 of the gate state)
+    SidechainFilter sidechain[Channels]; // keys the gate detector, keeps its state between blocks
+    PeakDetector detector[Channels];     // sliding window peak of the sidechain, length set by "Detector (ms)"
+    MultiTapDelay echo[Channels];        // feedback delay
+    DelayLine lookahead[Channels];       // holds the audio back behind the detector (or the spectral gate)
+    SpectralGate<Channels> spectral;     // the multiband gate, with its own per-channel state
+    float pfEnvelopeState[Channels];     // gate envelope, 0 closed to 1 open (see GateEnvelope.h)
+    float pfHoldState[Channels];         // samples of hold left
+    int piStage[Channels];               // GateEnvelope::Stage
+    TruePeak meterTruePeak[Channels];    // 4x oversampled output, for the true peak
+    float pfMeterPeak[Channels];         // output sample peak so far in the current measuring window
+    float pfMeterTruePeak[Channels];     // its true peak
+    float pfMeterSquares[Channels];      // and the sum of its squares
+    float pfMeterLevel[Channels];        // the meter controls' level, scaled and decayed window by window
+    int piQuiet[Channels];               // samples of silent input in a row
+    bool pbIdle[Channels];               // the channel is resting, silent out (see beginBlock())
+    bool pbKeyIdle[Channels];            // the sidechain is parked (see keyIdle())
+
+    // shared by every channel
+    Settings settings;
+    bool bSettingsChanged;
+    const Program *pMorphTarget;       // a morph in progress: where it is going,
+    GateLevels morphGate;              // and the levels and filter design it started from
+    SidechainFilter::Coefficients morphFilter;
+    int iMorphLength, iMorphLeft;
+    GateMode gateMode;
+    GateLevels gate;
+    OutputGains gains;
+    float fSampleRate;
+    Link link;
+    int iMeasuredLength, iMeasuredItems;
+    int iLookahead;
+    MeterRing<Channels> telemetry;
+    StageProfiler profiler;
+    pcm::Dither dither;                // processPcm()'s output dither
+    float fMaxDelayTime;               // ms the echo lines are sized for, and how they store samples
+    MultiTapDelay::Storage delayStorage;
+    const Program *pPendingProgram;    // loadProgram()'s program and morph length, put in place at
+    int iPendingMorph;                 // the start of the next grid block
+    float fHostRate;                   // the rate the host last gave
+    int iGridPhase;                    // samples into the current grid block
+};
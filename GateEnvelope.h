@@ -0,0 +1,74 @@
+//
+//  GateEnvelope.h
+//  MyEffect Gate Envelope
+//
+//  The gate's ballistics, shared by GateEngine, GateBatch and the spectral gate so they all
+//  open and close the same way. Each gate is a small state machine:
+//
+//    CLOSED  -> ATTACK   the key goes above the threshold
+//    ATTACK  -> OPEN     the envelope has reached 1 (an attack always finishes)
+//    OPEN    -> HOLD     the key drops back below the threshold; the hold counts down from here
+//    HOLD    -> RELEASE  the hold has run out and the key is below threshold - hysteresis
+//    RELEASE -> CLOSED   the envelope has reached 0
+//
+//  and the key going above the threshold again sends any stage back to ATTACK (or OPEN if
+//  it's already fully open) and restarts the hold. The envelope runs from 0 (closed) to 1 (open)
+//  and moves every sample by a one-pole step towards 1 in ATTACK, or towards 0 in RELEASE,
+//  snapping to the end once it is within kSnap of it. The time constants are set so the snap
+//  comes at the attack / release time on the control, as the linear ramps used to reach the end.
+//
+//  The gain goes from the reduction depth at 0 to unity at 1 in proportion to the envelope, so
+//  in a release its distance above the floor gain decays exponentially. With a full mute (a
+//  floor of 0) that is a straight line in dB, as an analogue gate's release; with a finite floor
+//  the dB curve falls quickly at first and flattens out as it nears the floor. The coefficients
+//  are only worked out when a control (or the sample rate) changes.
+//
+
+#pragma once
+
+#include <cmath>
+
+struct GateEnvelope
+{
+    enum Stage { CLOSED, ATTACK, OPEN, HOLD, RELEASE };
+
+    static constexpr float kSnap = 1e-3f; // the envelope snaps to 0 or 1 this close to it
+
+    // the one-pole coefficient for a step per sample that reaches kSnap of the end in fMs (0 ms is instant)
+    static float coefficient(float fMs, float fSampleRate)
+    {
+        float fSamples = 0.001f * fMs * fSampleRate;
+        if (!(fSamples > 1))
+            return 1;
+        return 1 - expf(logf(kSnap) / fSamples);
+    }
+
+    // the coefficient for iSteps samples at once
+    static float coefficient(float fPerSample, int iSteps) { return 1 - powf(1 - fPerSample, (float)iSteps); }
+
+    // the gain for an envelope value, exactly fFloor closed and exactly 1 open
+    static inline float gain(float fFloor, float fEnvelope) { return fEnvelope == 1 ? 1 : fFloor + (1 - fFloor) * fEnvelope; }
+
+    // One step of a gate: fPeak is the key, fElapsed the samples the step covers (the hold
+    // counts down by it). Written as selects rather than branches, so GateBatch's loops over
+    // lanes can use it too, with the same results.
+    static inline void step(float fPeak, float fOpen, float fClose, float fAttack, float fRelease, float fHoldLength,
+                            float fElapsed, float& fEnvelope, float& fHold, int& iStage)
+    {
+        bool bKey = fPeak > fOpen;
+        float fLeft = fHold - fElapsed;
+        fHold = bKey ? fHoldLength : (fLeft > 0 ? fLeft : 0);
+
+        int iNext = bKey ? (fEnvelope < 1 ? ATTACK : OPEN) : (iStage == OPEN ? HOLD : iStage);
+        iNext = (iNext == HOLD && fHold <= 0 && fPeak < fClose) ? RELEASE : iNext;
+
+        float fUp = fEnvelope + (1 - fEnvelope) * fAttack;
+        fUp = 1 - fUp < kSnap ? 1 : fUp;
+        float fDown = fEnvelope - fEnvelope * fRelease;
+        fDown = fDown < kSnap ? 0 : fDown;
+        fEnvelope = iNext == ATTACK ? fUp : (iNext == RELEASE ? fDown : fEnvelope);
+
+        iNext = (iNext == ATTACK && fEnvelope == 1) ? OPEN : iNext;
+        iStage = (iNext == RELEASE && fEnvelope == 0) ? CLOSED : iNext;
+    }
+};
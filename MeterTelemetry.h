@@ -0,0 +1,109 @@
+//
+//  MeterTelemetry.h
+//  MyEffect Meter Telemetry
+//
+//  The audio thread only measures: at the end of every 1 ms measuring window it pushes the raw
+//  output sample peak, true peak (see TruePeak.h), mean square and gate gain of each channel
+//  into a MeterRing. The output is measured after the delay mix, so the readings are the level
+//  that actually leaves the plugin. The dB conversion and the gain-reduction history are done in
+//  MeterDisplay, on whichever thread reads the ring (a UI timer or a monitoring thread). The
+//  exception is the L / R meter controls: the host reads those from the plugin's parameters,
+//  which only the audio thread writes, so the engine runs each window through
+//  MeterDisplay::meterLevel() itself and the plugin writes the result at the end of the block.
+//
+
+#pragma once
+
+#include <cmath>
+
+#include "FastMath.h"
+#include "SpscRing.h"
+
+// one measuring window, as measured on the audio thread
+template <int Channels>
+struct MeterFrame
+{
+    float pfPeak[Channels];       // largest output sample magnitude
+    float pfTruePeak[Channels];   // largest magnitude between the samples too (never below pfPeak)
+    float pfMeanSquare[Channels]; // mean of the squared output
+    float pfGain[Channels];       // gate gain at the end of the window (1 = no reduction)
+};
+
+// room for a quarter of a second of 1 ms windows between polls
+template <int Channels>
+using MeterRing = SpscRing<MeterFrame<Channels>, 256>;
+
+template <int Channels>
+class MeterDisplay
+{
+public:
+    static const int kHistory = 1024; // windows of gain-reduction history kept (about a second)
+
+    MeterDisplay() : iHistoryWrite(0)
+    {
+        for (int c = 0; c < Channels; c++) {
+            pfPeakDb[c] = pfTruePeakDb[c] = pfRmsDb[c] = -144;
+            pfReductionDb[c] = 0;
+            for (int h = 0; h < kHistory; h++)
+                ppfHistory[c][h] = 0;
+        }
+    }
+
+    // takes every window waiting in the ring; returns how many there were
+    int poll(MeterRing<Channels>& ring)
+    {
+        MeterFrame<Channels> frame;
+        int iFrames = 0;
+
+        while (ring.pop(frame)) {
+            for (int c = 0; c < Channels; c++) {
+                pfPeakDb[c] = floorDb(fastmath::gainToDb(frame.pfPeak[c]));
+                pfTruePeakDb[c] = floorDb(fastmath::gainToDb(frame.pfTruePeak[c]));
+                pfRmsDb[c] = floorDb(0.5f * fastmath::gainToDb(frame.pfMeanSquare[c]));
+                pfReductionDb[c] = -floorDb(fastmath::gainToDb(frame.pfGain[c]));
+                ppfHistory[c][iHistoryWrite] = pfReductionDb[c];
+            }
+            iHistoryWrite = (iHistoryWrite + 1) % kHistory;
+            iFrames++;
+        }
+        return iFrames;
+    }
+
+    // levels of the last window: output sample peak, true peak (dBTP) and RMS (dBFS), and the
+    // gate's reduction (dB, positive)
+    float getPeakDb(int iChannel) const { return pfPeakDb[iChannel]; }
+    float getTruePeakDb(int iChannel) const { return pfTruePeakDb[iChannel]; }
+    float getRmsDb(int iChannel) const { return pfRmsDb[iChannel]; }
+    float getReductionDb(int iChannel) const { return pfReductionDb[iChannel]; }
+
+    // copies the last iCount windows of gain reduction (dB), oldest first; iCount <= kHistory
+    void getReductionHistory(int iChannel, float *pfOut, int iCount) const
+    {
+        for (int i = 0; i < iCount; i++)
+            pfOut[i] = ppfHistory[iChannel][(iHistoryWrite - iCount + i + kHistory) % kHistory];
+    }
+
+    // the level the "L Meter" / "R Meter" controls show, 0..1: scales a window's output true peak
+    // into the meter range, with the slow decay from fOld (the level after the window before)
+    static float meterLevel(float fPeak, float fOld)
+    {
+        const float fMeterScale = 0.6242126f; // 1 / log10(40)
+
+        //scales and offsets the values into a useable range (silence is exactly 0: the fast log
+        //is a few parts in a million out at 1, which would hold the meter just above the floor)
+        float fMax = fPeak > 0 ? fastmath::log10(fPeak * 39 + 1) * fMeterScale : 0.f;
+
+        //Making the slow decay
+        if (fMax < fOld){
+            fMax = (fMax * 0.01 + fOld * 0.99);
+        }
+        return fMax;
+    }
+
+private:
+    static float floorDb(float fDb) { return fDb < -144 ? -144 : fDb; } // silence reads as -144 dB
+
+    float pfPeakDb[Channels], pfTruePeakDb[Channels], pfRmsDb[Channels], pfReductionDb[Channels];
+    float ppfHistory[Channels][kHistory];
+    int iHistoryWrite;
+};
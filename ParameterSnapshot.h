@@ -0,0 +1,86 @@
+//
+//  ParameterSnapshot.h
+//  MyEffect Parameter Snapshot
+//
+//  Takes one consistent copy of every control at the start of a block, so the whole block runs
+//  on the same values however the host changes them meanwhile, and notes which ones changed
+//  since the last block. Controls are read with get<Index>(), so an index past the end of the
+//  control list is a compile error rather than a read off the end of the array. Controls the
+//  plugin itself writes (the meters) can be marked as outputs, and are then left out.
+//
+
+#pragma once
+
+#include <cstdint>
+
+template <int NumControls>
+class ParameterSnapshot
+{
+    static_assert(NumControls > 0 && NumControls <= 64, "dirty flags are one 64-bit mask");
+
+public:
+    ParameterSnapshot() : uDirty(0), uOutputs(0), bFirst(true)
+    {
+        for (int i = 0; i < NumControls; i++)
+            pfValues[i] = 0;
+    }
+
+    // a control the plugin writes rather than reads; capture() skips it
+    template <int Index>
+    void setOutput()
+    {
+        static_assert(Index >= 0 && Index < NumControls, "control index out of range");
+        uOutputs |= (uint64_t)1 << Index;
+    }
+
+    // copies controls 0..NumControls-1 from anything indexable (the plugin's parameters) and
+    // marks the ones that differ from the last snapshot; everything counts as changed the first time
+    template <typename Source>
+    void capture(Source& source)
+    {
+        uDirty = bFirst ? ~uOutputs : 0;
+        for (int i = 0; i < NumControls; i++) {
+            if ((uOutputs >> i) & 1)
+                continue;
+            float fValue = source[i];
+            if (fValue != pfValues[i]) {
+                pfValues[i] = fValue;
+                uDirty |= (uint64_t)1 << i;
+            }
+        }
+        bFirst = false;
+    }
+
+    // overrides one control in this snapshot (e.g. a menu item that arrives through optionChanged())
+    template <int Index>
+    void set(float fValue)
+    {
+        static_assert(Index >= 0 && Index < NumControls, "control index out of range");
+        if (fValue != pfValues[Index]) {
+            pfValues[Index] = fValue;
+            uDirty |= (uint64_t)1 << Index;
+        }
+    }
+
+    template <int Index>
+    float get() const
+    {
+        static_assert(Index >= 0 && Index < NumControls, "control index out of range");
+        return pfValues[Index];
+    }
+
+    template <int Index>
+    bool changed() const
+    {
+        static_assert(Index >= 0 && Index < NumControls, "control index out of range");
+        return (uDirty >> Index) & 1;
+    }
+
+    bool anyChanged() const { return uDirty != 0; }
+
+private:
+    float pfValues[NumControls];
+    uint64_t uDirty;    // bit i: control i changed in the last capture()
+    uint64_t uOutputs;  // bit i: control i is written by the plugin
+    bool bFirst;
+};
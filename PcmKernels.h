@@ -0,0 +1,366 @@
+//
+//  PcmKernels.h
+//  MyEffect PCM Kernels
+//
+//  Conversion between interleaved integer PCM, as capture and playout hardware delivers it, and
+//  the engine's deinterleaved float blocks, so GateEngine::processPcm() can read straight from
+//  the device buffer and write straight back to it with no conversion passes of the host's own.
+//  Each kernel converts, scales and (de)interleaves in one go, with an AVX2 path (8 floats) and
+//  an SSE path (4 floats) for mono and stereo, and a scalar loop for the remainder and for any
+//  other channel count.
+//
+//  Samples are little-endian: INT16, INT24 packed in 3 bytes, and INT32. Full scale is +-1.0,
+//  i.e. a float is multiplied by 2^15, 2^23 or 2^31 on the way out and divided on the way in, so
+//  an INT16 or INT24 round trip without dither gives back the same integers. Output is clipped, and INT16 and
+//  INT24 are dithered with 1 LSB of triangular (TPDF) noise; INT32 has more resolution than a
+//  float carries, so it is not.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pcm {
+
+enum Format { INT16, INT24, INT32 };
+
+inline int bytesPerSample(Format format) { return format == INT16 ? 2 : (format == INT24 ? 3 : 4); }
+
+// Triangular dither noise, 1 LSB each side. Eight xorshift generators take turns, one per
+// interleaved sample, so the SIMD paths can run them side by side; every path gives sample n
+// of a write() the noise from generator n % 8, so output is the same on every instruction set.
+struct Dither
+{
+    static const int kLanes = 8;
+
+    Dither() { reset(); }
+
+    void reset(uint32_t uSeed = 0x9E3779B9u)
+    {
+        for (int l = 0; l < kLanes; l++)
+            puState[l] = (uSeed + 0x6D2B79F5u * (l + 1)) | 1; //never 0, where xorshift would stay
+    }
+
+    static inline uint32_t step(uint32_t u)
+    {
+        u ^= u << 13;
+        u ^= u >> 17;
+        u ^= u << 5;
+        return u;
+    }
+
+    // the next value of generator iLane, in LSBs: the difference of two uniform draws
+    inline float next(int iLane)
+    {
+        uint32_t uA = step(puState[iLane]);
+        uint32_t uB = step(uA);
+        puState[iLane] = uB;
+        return (float)((int32_t)(uA >> 8) - (int32_t)(uB >> 8)) * (1.0f / 16777216);
+    }
+
+    alignas(32) uint32_t puState[kLanes];
+};
+
+namespace detail {
+
+template <Format F> struct Traits;
+template <> struct Traits<INT16>
+{
+    static const int kBytes = 2, kOverread = 0;
+    static constexpr float kScale = 32768.0f, kMax = 32767.0f;
+};
+template <> struct Traits<INT24>
+{
+    static const int kBytes = 3, kOverread = 4; // the AVX2 load reads 16 bytes for every 12 it uses
+    static constexpr float kScale = 8388608.0f, kMax = 8388607.0f;
+};
+template <> struct Traits<INT32>
+{
+    static const int kBytes = 4, kOverread = 0;
+    static constexpr float kScale = 2147483648.0f, kMax = 2147483520.0f; // the largest float below 2^31
+};
+
+template <Format F> inline int32_t loadSample(const uint8_t *p);
+template <> inline int32_t loadSample<INT16>(const uint8_t *p) { int16_t i; memcpy(&i, p, 2); return i; }
+template <> inline int32_t loadSample<INT24>(const uint8_t *p) { return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8; }
+template <> inline int32_t loadSample<INT32>(const uint8_t *p) { int32_t i; memcpy(&i, p, 4); return i; }
+
+template <Format F> inline void storeSample(uint8_t *p, int32_t i);
+template <> inline void storeSample<INT16>(uint8_t *p, int32_t i) { int16_t s = (int16_t)i; memcpy(p, &s, 2); }
+template <> inline void storeSample<INT24>(uint8_t *p, int32_t i) { p[0] = (uint8_t)i; p[1] = (uint8_t)(i >> 8); p[2] = (uint8_t)(i >> 16); }
+template <> inline void storeSample<INT32>(uint8_t *p, int32_t i) { memcpy(p, &i, 4); }
+
+// scaled, dithered, clipped and rounded to the nearest integer (as cvtps rounds)
+template <Format F> inline int32_t quantise(float fSample, float fDither)
+{
+    float f = fSample * Traits<F>::kScale + fDither;
+    f = f < Traits<F>::kMax ? f : Traits<F>::kMax;
+    f = f > -Traits<F>::kScale ? f : -Traits<F>::kScale;
+    return (int32_t)nearbyintf(f);
+}
+
+#if defined(__AVX2__)
+// eight interleaved samples to eight ints
+template <Format F> inline __m256i load8(const uint8_t *p);
+template <> inline __m256i load8<INT16>(const uint8_t *p) { return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p)); }
+template <> inline __m256i load8<INT24>(const uint8_t *p)
+{
+    //four samples from each 16 bytes, moved to the top three bytes of each int and shifted back down with their sign
+    const __m256i spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                            _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+    return _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, spread), 8);
+}
+template <> inline __m256i load8<INT32>(const uint8_t *p) { return _mm256_loadu_si256((const __m256i*)p); }
+
+template <Format F> inline void store8(uint8_t *p, __m256i i);
+template <> inline void store8<INT16>(uint8_t *p, __m256i i)
+{
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(i, i), 0x08);
+    _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(packed));
+}
+template <> inline void store8<INT24>(uint8_t *p, __m256i i)
+{
+    //the low three bytes of each int, twelve to a lane, written as 8 + 4 bytes so nothing past the end is touched
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m256i packed = _mm256_shuffle_epi8(i, pack);
+    __m128i lo = _mm256_castsi256_si128(packed), hi = _mm256_extracti128_si256(packed, 1);
+    int32_t iLoTail = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8)), iHiTail = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+    _mm_storel_epi64((__m128i*)p, lo);
+    memcpy(p + 8, &iLoTail, 4);
+    _mm_storel_epi64((__m128i*)(p + 12), hi);
+    memcpy(p + 20, &iHiTail, 4);
+}
+template <> inline void store8<INT32>(uint8_t *p, __m256i i) { _mm256_storeu_si256((__m256i*)p, i); }
+
+// the next eight dither values, generator l in lane l (as Dither::next())
+inline __m256 dither8(__m256i& state)
+{
+    __m256i a = state;
+    a = _mm256_xor_si256(a, _mm256_slli_epi32(a, 13));
+    a = _mm256_xor_si256(a, _mm256_srli_epi32(a, 17));
+    a = _mm256_xor_si256(a, _mm256_slli_epi32(a, 5));
+    __m256i b = a;
+    b = _mm256_xor_si256(b, _mm256_slli_epi32(b, 13));
+    b = _mm256_xor_si256(b, _mm256_srli_epi32(b, 17));
+    b = _mm256_xor_si256(b, _mm256_slli_epi32(b, 5));
+    state = b;
+    __m256i diff = _mm256_sub_epi32(_mm256_srli_epi32(a, 8), _mm256_srli_epi32(b, 8));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(diff), _mm256_set1_ps(1.0f / 16777216));
+}
+
+template <Format F, bool bDither> inline __m256i quantise8(__m256 x, __m256i& state)
+{
+    x = _mm256_mul_ps(x, _mm256_set1_ps(Traits<F>::kScale));
+    if (bDither)
+        x = _mm256_add_ps(x, dither8(state));
+    x = _mm256_min_ps(x, _mm256_set1_ps(Traits<F>::kMax));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-Traits<F>::kScale));
+    return _mm256_cvtps_epi32(x);
+}
+#elif defined(__SSE2__)
+// four interleaved samples to four ints (INT24 has no byte shuffle before SSSE3, so goes a sample at a time)
+template <Format F> inline __m128i load4(const uint8_t *p);
+template <> inline __m128i load4<INT16>(const uint8_t *p)
+{
+    __m128i i = _mm_loadl_epi64((const __m128i*)p);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(i, i), 16);
+}
+template <> inline __m128i load4<INT24>(const uint8_t *p)
+{
+    return _mm_setr_epi32(loadSample<INT24>(p), loadSample<INT24>(p + 3), loadSample<INT24>(p + 6), loadSample<INT24>(p + 9));
+}
+template <> inline __m128i load4<INT32>(const uint8_t *p) { return _mm_loadu_si128((const __m128i*)p); }
+
+template <Format F> inline void store4(uint8_t *p, __m128i i);
+template <> inline void store4<INT16>(uint8_t *p, __m128i i) { _mm_storel_epi64((__m128i*)p, _mm_packs_epi32(i, i)); }
+template <> inline void store4<INT24>(uint8_t *p, __m128i i)
+{
+    alignas(16) int32_t pi[4];
+    _mm_store_si128((__m128i*)pi, i);
+    for (int k = 0; k < 4; k++)
+        storeSample<INT24>(p + 3 * k, pi[k]);
+}
+template <> inline void store4<INT32>(uint8_t *p, __m128i i) { _mm_storeu_si128((__m128i*)p, i); }
+
+// the next four dither values from generators l..l+3 (as Dither::next())
+inline __m128 dither4(__m128i& state)
+{
+    __m128i a = state;
+    a = _mm_xor_si128(a, _mm_slli_epi32(a, 13));
+    a = _mm_xor_si128(a, _mm_srli_epi32(a, 17));
+    a = _mm_xor_si128(a, _mm_slli_epi32(a, 5));
+    __m128i b = a;
+    b = _mm_xor_si128(b, _mm_slli_epi32(b, 13));
+    b = _mm_xor_si128(b, _mm_srli_epi32(b, 17));
+    b = _mm_xor_si128(b, _mm_slli_epi32(b, 5));
+    state = b;
+    __m128i diff = _mm_sub_epi32(_mm_srli_epi32(a, 8), _mm_srli_epi32(b, 8));
+    return _mm_mul_ps(_mm_cvtepi32_ps(diff), _mm_set1_ps(1.0f / 16777216));
+}
+
+template <Format F, bool bDither> inline __m128i quantise4(__m128 x, __m128i& state)
+{
+    x = _mm_mul_ps(x, _mm_set1_ps(Traits<F>::kScale));
+    if (bDither)
+        x = _mm_add_ps(x, dither4(state));
+    x = _mm_min_ps(x, _mm_set1_ps(Traits<F>::kMax));
+    x = _mm_max_ps(x, _mm_set1_ps(-Traits<F>::kScale));
+    return _mm_cvtps_epi32(x);
+}
+#endif
+
+template <Format F>
+void read(const uint8_t *pIn, int iChannels, float* const* ppOut, int iFrames)
+{
+    const int kBytes = Traits<F>::kBytes;
+    const float fInverse = 1 / Traits<F>::kScale;
+    //how many frames the vector loops may start at and still not read past the end of the buffer
+    int iSafe = iFrames - (Traits<F>::kOverread + iChannels * kBytes - 1) / (iChannels * kBytes);
+    int f = 0;
+
+    if (iChannels == 2) {
+        float *pfL = ppOut[0], *pfR = ppOut[1];
+#if defined(__AVX2__)
+        const __m256i evenOdd = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        const __m256 inverse = _mm256_set1_ps(fInverse);
+        for (; f + 8 <= iSafe; f += 8) {
+            const uint8_t *p = pIn + 2 * f * kBytes;
+            //L0 R0 .. L3 R3 and L4 R4 .. L7 R7, sorted to L0..L3 R0..R3 and L4..L7 R4..R7
+            __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(load8<F>(p)), inverse);
+            __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(load8<F>(p + 8 * kBytes)), inverse);
+            a = _mm256_permutevar8x32_ps(a, evenOdd);
+            b = _mm256_permutevar8x32_ps(b, evenOdd);
+            _mm256_storeu_ps(pfL + f, _mm256_permute2f128_ps(a, b, 0x20));
+            _mm256_storeu_ps(pfR + f, _mm256_permute2f128_ps(a, b, 0x31));
+        }
+#elif defined(__SSE2__)
+        const __m128 inverse = _mm_set1_ps(fInverse);
+        for (; f + 4 <= iSafe; f += 4) {
+            const uint8_t *p = pIn + 2 * f * kBytes;
+            __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(load4<F>(p)), inverse);
+            __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(load4<F>(p + 4 * kBytes)), inverse);
+            _mm_storeu_ps(pfL + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(pfR + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+#endif
+    }
+    else if (iChannels == 1) {
+        float *pfOut = ppOut[0];
+#if defined(__AVX2__)
+        const __m256 inverse = _mm256_set1_ps(fInverse);
+        for (; f + 8 <= iSafe; f += 8)
+            _mm256_storeu_ps(pfOut + f, _mm256_mul_ps(_mm256_cvtepi32_ps(load8<F>(pIn + f * kBytes)), inverse));
+#elif defined(__SSE2__)
+        const __m128 inverse = _mm_set1_ps(fInverse);
+        for (; f + 4 <= iSafe; f += 4)
+            _mm_storeu_ps(pfOut + f, _mm_mul_ps(_mm_cvtepi32_ps(load4<F>(pIn + f * kBytes)), inverse));
+#endif
+    }
+
+    for (; f < iFrames; f++)
+        for (int c = 0; c < iChannels; c++)
+            ppOut[c][f] = (float)loadSample<F>(pIn + (f * iChannels + c) * kBytes) * fInverse;
+}
+
+template <Format F, bool bDither>
+void write(const float* const* ppIn, int iChannels, uint8_t *pOut, int iFrames, Dither& dither)
+{
+    const int kBytes = Traits<F>::kBytes;
+    int f = 0;
+
+    if (iChannels == 2) {
+        const float *pfL = ppIn[0], *pfR = ppIn[1];
+#if defined(__AVX2__)
+        __m256i state = _mm256_load_si256((const __m256i*)dither.puState);
+        for (; f + 8 <= iFrames; f += 8) {
+            uint8_t *p = pOut + 2 * f * kBytes;
+            //L0..L7 and R0..R7 to L0 R0 .. L3 R3 and L4 R4 .. L7 R7
+            __m256 l = _mm256_loadu_ps(pfL + f), r = _mm256_loadu_ps(pfR + f);
+            __m256 lo = _mm256_unpacklo_ps(l, r), hi = _mm256_unpackhi_ps(l, r);
+            store8<F>(p, quantise8<F, bDither>(_mm256_permute2f128_ps(lo, hi, 0x20), state));
+            store8<F>(p + 8 * kBytes, quantise8<F, bDither>(_mm256_permute2f128_ps(lo, hi, 0x31), state));
+        }
+        _mm256_store_si256((__m256i*)dither.puState, state);
+#elif defined(__SSE2__)
+        __m128i stateLo = _mm_load_si128((const __m128i*)dither.puState), stateHi = _mm_load_si128((const __m128i*)(dither.puState + 4));
+        for (; f + 4 <= iFrames; f += 4) {
+            uint8_t *p = pOut + 2 * f * kBytes;
+            __m128 l = _mm_loadu_ps(pfL + f), r = _mm_loadu_ps(pfR + f);
+            store4<F>(p, quantise4<F, bDither>(_mm_unpacklo_ps(l, r), stateLo));
+            store4<F>(p + 4 * kBytes, quantise4<F, bDither>(_mm_unpackhi_ps(l, r), stateHi));
+        }
+        _mm_store_si128((__m128i*)dither.puState, stateLo);
+        _mm_store_si128((__m128i*)(dither.puState + 4), stateHi);
+#endif
+    }
+    else if (iChannels == 1) {
+        const float *pfIn = ppIn[0];
+#if defined(__AVX2__)
+        __m256i state = _mm256_load_si256((const __m256i*)dither.puState);
+        for (; f + 8 <= iFrames; f += 8)
+            store8<F>(pOut + f * kBytes, quantise8<F, bDither>(_mm256_loadu_ps(pfIn + f), state));
+        _mm256_store_si256((__m256i*)dither.puState, state);
+#elif defined(__SSE2__)
+        __m128i stateLo = _mm_load_si128((const __m128i*)dither.puState), stateHi = _mm_load_si128((const __m128i*)(dither.puState + 4));
+        for (; f + 8 <= iFrames; f += 8) {
+            store4<F>(pOut + f * kBytes, quantise4<F, bDither>(_mm_loadu_ps(pfIn + f), stateLo));
+            store4<F>(pOut + (f + 4) * kBytes, quantise4<F, bDither>(_mm_loadu_ps(pfIn + f + 4), stateHi));
+        }
+        _mm_store_si128((__m128i*)dither.puState, stateLo);
+        _mm_store_si128((__m128i*)(dither.puState + 4), stateHi);
+#endif
+    }
+
+    //the vector loops stop on a whole number of eight-sample groups, so the generators carry on in turn from 0
+    int iSample = 0;
+    for (; f < iFrames; f++)
+        for (int c = 0; c < iChannels; c++, iSample++) {
+            float fDither = bDither ? dither.next(iSample % Dither::kLanes) : 0;
+            storeSample<F>(pOut + (f * iChannels + c) * kBytes, quantise<F>(ppIn[c][f], fDither));
+        }
+}
+
+} // namespace detail
+
+// iFrames interleaved frames of iChannels samples in pIn to one float buffer per channel in ppOut
+inline void read(Format format, const void *pIn, int iChannels, float* const* ppOut, int iFrames)
+{
+    const uint8_t *p = (const uint8_t*)pIn;
+    switch (format) {
+        case INT16: detail::read<INT16>(p, iChannels, ppOut, iFrames); break;
+        case INT24: detail::read<INT24>(p, iChannels, ppOut, iFrames); break;
+        case INT32: detail::read<INT32>(p, iChannels, ppOut, iFrames); break;
+    }
+}
+
+// and back again, clipped to the format's range and, given a pDither, dithered (INT16 and INT24)
+inline void write(const float* const* ppIn, int iChannels, Format format, void *pOut, int iFrames, Dither *pDither)
+{
+    uint8_t *p = (uint8_t*)pOut;
+    Dither undithered;
+    Dither& dither = pDither ? *pDither : undithered;
+    switch (format) {
+        case INT16:
+            if (pDither) detail::write<INT16, true>(ppIn, iChannels, p, iFrames, dither);
+            else detail::write<INT16, false>(ppIn, iChannels, p, iFrames, dither);
+            break;
+        case INT24:
+            if (pDither) detail::write<INT24, true>(ppIn, iChannels, p, iFrames, dither);
+            else detail::write<INT24, false>(ppIn, iChannels, p, iFrames, dither);
+            break;
+        case INT32: detail::write<INT32, false>(ppIn, iChannels, p, iFrames, dither); break;
+    }
+}
+
+} // namespace pcm
@@ -0,0 +1,142 @@
+//
+//  PeakDetector.h
+//  MyEffect Sliding Window Peak Detector
+//
+//  Gives the largest magnitude over the last N samples, updated every sample, so the gate can
+//  make a decision on every sample instead of once per fixed window. Uses the van Herk /
+//  Gil-Werman scheme: time is cut into blocks of N samples, and the peak of a window is the
+//  larger of the running peak since the start of the current block and the peak of the rest of
+//  the previous block (kept as a table of suffix maxima, rebuilt once per block). That is about
+//  three operations per sample with no data-dependent branches, whatever the window length.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class PeakDetector
+{
+public:
+    PeakDetector() : iLength(1), iPosition(0), fRunning(0), uWrite(0), uMask(0) { setMaxLength(1); }
+
+    // sizes the tables for windows up to iMaxLength samples (allocates: not for the audio thread)
+    void setMaxLength(int iMaxLength)
+    {
+        if (iMaxLength < 1) iMaxLength = 1;
+        uint32_t uCapacity = 1;
+        while (uCapacity < (uint32_t)iMaxLength)
+            uCapacity <<= 1;
+        history.assign(uCapacity, 0.f);
+        suffix.assign(iMaxLength + 1, 0.f);
+        uMask = uCapacity - 1;
+        iMaxWindow = iMaxLength;
+        if (iLength > iMaxLength)
+            iLength = iMaxLength;
+        reset();
+    }
+    int getMaxLength() const { return iMaxWindow; }
+
+    // window length in samples, clamped to 1..getMaxLength()
+    void setLength(int iNewLength)
+    {
+        if (iNewLength < 1) iNewLength = 1;
+        if (iNewLength > iMaxWindow) iNewLength = iMaxWindow;
+        if (iNewLength != iLength) {
+            iLength = iNewLength;
+            startBlock(); // carries on from the recent history, so there is no gap in detection
+        }
+    }
+    int getLength() const { return iLength; }
+
+    void reset()
+    {
+        for (float& fValue : history) fValue = 0;
+        for (float& fValue : suffix) fValue = 0;
+        iPosition = 0;
+        fRunning = 0;
+    }
+
+    // pfOut[i] is the peak magnitude of the window ending at pfIn[i] (pfOut may be pfIn)
+    void process(const float *pfIn, float *pfOut, int iCount)
+    {
+        float *pfHistory = history.data();
+        const float *pfSuffix = suffix.data();
+
+        while (iCount > 0) {
+            int iRun = iLength - iPosition; // samples left in the current block
+            if (iRun > iCount) iRun = iCount;
+
+            float fPeak = fRunning;
+            const float *pfRest = pfSuffix + iPosition + 1; // rest of the previous block, one step further on each sample
+            int i = 0;
+#if defined(__SSE2__)
+            // four samples at a time: the running peak is a prefix max, done as a log-step scan
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+            __m128 running = _mm_set1_ps(fPeak);
+            for (; i + 4 <= iRun; i += 4) {
+                __m128 level = _mm_and_ps(_mm_loadu_ps(pfIn + i), absMask);
+                uint32_t uAt = (uWrite + i) & uMask;
+                if (uAt + 4 <= uMask + 1)
+                    _mm_storeu_ps(pfHistory + uAt, level);
+                else {
+                    float pfLevel[4];
+                    _mm_storeu_ps(pfLevel, level);
+                    for (int k = 0; k < 4; k++)
+                        pfHistory[(uAt + k) & uMask] = pfLevel[k];
+                }
+                __m128 scan = _mm_max_ps(level, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(level), 4)));
+                scan = _mm_max_ps(scan, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(scan), 8)));
+                scan = _mm_max_ps(scan, running);
+                _mm_storeu_ps(pfOut + i, _mm_max_ps(scan, _mm_loadu_ps(pfRest + i)));
+                running = _mm_shuffle_ps(scan, scan, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+            fPeak = _mm_cvtss_f32(running);
+#endif
+            for (; i < iRun; i++) {
+                float fLevel = fabsf(pfIn[i]);
+                pfHistory[(uWrite + i) & uMask] = fLevel;
+                fPeak = fLevel > fPeak ? fLevel : fPeak;
+                pfOut[i] = pfRest[i] > fPeak ? pfRest[i] : fPeak;
+            }
+            fRunning = fPeak;
+            uWrite += iRun;
+            iPosition += iRun;
+
+            if (iPosition == iLength)
+                startBlock();
+
+            pfIn += iRun;
+            pfOut += iRun;
+            iCount -= iRun;
+        }
+    }
+
+private:
+    // builds the suffix maxima of the last iLength samples and starts a new block
+    void startBlock()
+    {
+        float fPeak = 0;
+        suffix[iLength] = 0;
+        for (int j = iLength - 1; j >= 0; j--) {
+            float fLevel = history[(uWrite - iLength + j) & uMask];
+            fPeak = fLevel > fPeak ? fLevel : fPeak;
+            suffix[j] = fPeak;
+        }
+        iPosition = 0;
+        fRunning = 0;
+    }
+
+    int iLength, iMaxWindow;
+    int iPosition;      // samples into the current block
+    float fRunning;     // peak since the start of the current block
+    uint32_t uWrite;    // history write position (wraps harmlessly)
+    uint32_t uMask;
+    std::vector<float> history; // last getMaxLength() magnitudes (power-of-two ring)
+    std::vector<float> suffix;  // suffix[j]: peak of the previous block from its sample j onwards
+};
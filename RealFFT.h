@@ -0,0 +1,219 @@
+//
+//  RealFFT.h
+//  MyEffect Real FFT
+//
+//  FFT of a real signal of power-of-two length N, for the spectral gate. The N real samples
+//  are packed into N/2 complex ones (even samples real, odd imaginary), run through one
+//  complex FFT of half the length and then separated, so a transform costs about half of a
+//  complex one. The complex FFT works on split arrays (real parts in one, imaginary in the
+//  other), iterative radix-2 with the twiddles of each pass stored contiguously, so every pass
+//  from the third on is whole-vector butterflies (simd::butterflies()).
+//
+//  The spectrum is the N/2 + 1 bins from DC to Nyquist, unnormalised; inverse() undoes
+//  forward() exactly, scaling included.
+//
+
+#pragma once
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "SimdKernels.h"
+
+class RealFFT
+{
+public:
+    RealFFT() : iSize(0), iHalf(0) {}
+
+    // N, a power of two of at least 8 (allocates: not for the audio thread)
+    void setSize(int iNewSize)
+    {
+        iSize = iNewSize;
+        iHalf = iSize / 2;
+
+        //the swaps that put the half-length complex FFT's input in bit reversed order
+        int iBits = 0;
+        while ((1 << iBits) < iHalf)
+            iBits++;
+        swaps.clear();
+        for (int i = 0; i < iHalf; i++) {
+            int iReversed = 0;
+            for (int b = 0; b < iBits; b++)
+                iReversed |= ((i >> b) & 1) << (iBits - 1 - b);
+            if (i < iReversed)
+                swaps.push_back(std::make_pair(i, iReversed));
+        }
+
+        //twiddles of the pass with half-length h start at index h - 1
+        twiddleRe.assign(iHalf, 0.f);
+        twiddleIm.assign(iHalf, 0.f);
+        for (int h = 1; h < iHalf; h *= 2)
+            for (int j = 0; j < h; j++) {
+                twiddleRe[h - 1 + j] = (float)cos(M_PI * j / h);
+                twiddleIm[h - 1 + j] = (float)-sin(M_PI * j / h);
+            }
+
+        //twiddles that separate the packed spectrum, e^(-2 pi i k / N)
+        splitRe.assign(iHalf + 1, 0.f);
+        splitIm.assign(iHalf + 1, 0.f);
+        for (int k = 0; k <= iHalf; k++) {
+            splitRe[k] = (float)cos(2 * M_PI * k / iSize);
+            splitIm[k] = (float)-sin(2 * M_PI * k / iSize);
+        }
+        packedRe.assign(iHalf, 0.f);
+        packedIm.assign(iHalf, 0.f);
+    }
+    int getSize() const { return iSize; }
+    int getBins() const { return iHalf + 1; }
+
+    // pfIn: N samples; pfRe / pfIm: N/2 + 1 bins
+    void forward(const float *pfIn, float *pfRe, float *pfIm)
+    {
+        int k = 0;
+#if defined(__SSE2__)
+        for (; k + 4 <= iHalf; k += 4) {
+            __m128 a = _mm_loadu_ps(pfIn + 2 * k), b = _mm_loadu_ps(pfIn + 2 * k + 4);
+            _mm_storeu_ps(&packedRe[k], _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(&packedIm[k], _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+#endif
+        for (; k < iHalf; k++) {
+            packedRe[k] = pfIn[2 * k];
+            packedIm[k] = pfIn[2 * k + 1];
+        }
+        transform(packedRe.data(), packedIm.data());
+
+        //X[k] = E[k] + W^k O[k], where E and O are the spectra of the even and odd samples:
+        //E[k] = (Z[k] + conj Z[N/2 - k]) / 2 and O[k] = (Z[k] - conj Z[N/2 - k]) / 2i
+        const float *pfZRe = packedRe.data(), *pfZIm = packedIm.data();
+        k = 1;
+#if defined(__AVX2__)
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        for (; k + 8 <= iHalf; k += 8) {
+            __m256 ar = _mm256_loadu_ps(pfZRe + k), ai = _mm256_loadu_ps(pfZIm + k);
+            __m256 br = _mm256_permutevar8x32_ps(_mm256_loadu_ps(pfZRe + iHalf - k - 7), reverse);
+            __m256 bi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(pfZIm + iHalf - k - 7), reverse);
+            __m256 wr = _mm256_loadu_ps(&splitRe[k]), wi = _mm256_loadu_ps(&splitIm[k]);
+            __m256 evenRe = _mm256_mul_ps(half, _mm256_add_ps(ar, br)), evenIm = _mm256_mul_ps(half, _mm256_sub_ps(ai, bi));
+            __m256 oddRe = _mm256_mul_ps(half, _mm256_add_ps(ai, bi)), oddIm = _mm256_mul_ps(half, _mm256_sub_ps(br, ar));
+            _mm256_storeu_ps(pfRe + k, _mm256_add_ps(evenRe, _mm256_sub_ps(_mm256_mul_ps(wr, oddRe), _mm256_mul_ps(wi, oddIm))));
+            _mm256_storeu_ps(pfIm + k, _mm256_add_ps(evenIm, _mm256_add_ps(_mm256_mul_ps(wr, oddIm), _mm256_mul_ps(wi, oddRe))));
+        }
+#endif
+        for (; k <= iHalf; k++) {
+            int a = k < iHalf ? k : 0, b = iHalf - k;
+            float fEvenRe = 0.5f * (pfZRe[a] + pfZRe[b]), fEvenIm = 0.5f * (pfZIm[a] - pfZIm[b]);
+            float fOddRe = 0.5f * (pfZIm[a] + pfZIm[b]), fOddIm = 0.5f * (pfZRe[b] - pfZRe[a]);
+            pfRe[k] = fEvenRe + (splitRe[k] * fOddRe - splitIm[k] * fOddIm);
+            pfIm[k] = fEvenIm + (splitRe[k] * fOddIm + splitIm[k] * fOddRe);
+        }
+        pfRe[0] = pfZRe[0] + pfZIm[0]; // DC, where the twiddle is 1
+        pfIm[0] = 0;
+    }
+
+    // pfRe / pfIm: N/2 + 1 bins; pfOut: N samples
+    void inverse(const float *pfRe, const float *pfIm, float *pfOut)
+    {
+        //E[k] and O[k] back from X[k] and X[N/2 - k], repacked as E + iO and conjugated, so the
+        //forward transform runs it backwards
+        float *pfZRe = packedRe.data(), *pfZIm = packedIm.data();
+        int k = 0;
+#if defined(__AVX2__)
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        for (; k + 8 <= iHalf; k += 8) {
+            __m256 ar = _mm256_loadu_ps(pfRe + k), ai = _mm256_loadu_ps(pfIm + k);
+            __m256 br = _mm256_permutevar8x32_ps(_mm256_loadu_ps(pfRe + iHalf - k - 7), reverse);
+            __m256 bi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(pfIm + iHalf - k - 7), reverse);
+            __m256 wr = _mm256_loadu_ps(&splitRe[k]), wi = _mm256_loadu_ps(&splitIm[k]);
+            __m256 evenRe = _mm256_mul_ps(half, _mm256_add_ps(ar, br)), evenIm = _mm256_mul_ps(half, _mm256_sub_ps(ai, bi));
+            __m256 diffRe = _mm256_mul_ps(half, _mm256_sub_ps(ar, br)), diffIm = _mm256_mul_ps(half, _mm256_add_ps(ai, bi));
+            __m256 oddRe = _mm256_add_ps(_mm256_mul_ps(diffRe, wr), _mm256_mul_ps(diffIm, wi));
+            __m256 oddIm = _mm256_sub_ps(_mm256_mul_ps(diffIm, wr), _mm256_mul_ps(diffRe, wi));
+            _mm256_storeu_ps(pfZRe + k, _mm256_sub_ps(evenRe, oddIm));
+            _mm256_storeu_ps(pfZIm + k, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_add_ps(evenIm, oddRe)));
+        }
+#endif
+        for (; k < iHalf; k++) {
+            int b = iHalf - k;
+            float fEvenRe = 0.5f * (pfRe[k] + pfRe[b]), fEvenIm = 0.5f * (pfIm[k] - pfIm[b]);
+            float fDiffRe = 0.5f * (pfRe[k] - pfRe[b]), fDiffIm = 0.5f * (pfIm[k] + pfIm[b]);
+            float fOddRe = fDiffRe * splitRe[k] + fDiffIm * splitIm[k]; // times the conjugate twiddle
+            float fOddIm = fDiffIm * splitRe[k] - fDiffRe * splitIm[k];
+            pfZRe[k] = fEvenRe - fOddIm;
+            pfZIm[k] = -(fEvenIm + fOddRe);
+        }
+        transform(pfZRe, pfZIm);
+
+        float fScale = 1.0f / iHalf;
+        k = 0;
+#if defined(__SSE2__)
+        const __m128 scale = _mm_set1_ps(fScale), negativeScale = _mm_set1_ps(-fScale);
+        for (; k + 4 <= iHalf; k += 4) {
+            __m128 re = _mm_mul_ps(_mm_loadu_ps(pfZRe + k), scale), im = _mm_mul_ps(_mm_loadu_ps(pfZIm + k), negativeScale);
+            _mm_storeu_ps(pfOut + 2 * k, _mm_unpacklo_ps(re, im));
+            _mm_storeu_ps(pfOut + 2 * k + 4, _mm_unpackhi_ps(re, im));
+        }
+#endif
+        for (; k < iHalf; k++) {
+            pfOut[2 * k] = pfZRe[k] * fScale;
+            pfOut[2 * k + 1] = pfZIm[k] * -fScale;
+        }
+    }
+
+private:
+    // forward complex FFT of N/2 points, in place
+    void transform(float *pfRe, float *pfIm)
+    {
+        for (const std::pair<int, int>& swap : swaps) {
+            std::swap(pfRe[swap.first], pfRe[swap.second]);
+            std::swap(pfIm[swap.first], pfIm[swap.second]);
+        }
+
+        //the first two passes together, as radix-4 butterflies with trivial twiddles, four at a
+        //time: 4 x 4 points are transposed so each vector holds the same point of four butterflies
+        int i = 0;
+#if defined(__SSE2__)
+        for (; i + 16 <= iHalf; i += 16) {
+            __m128 pr0 = _mm_loadu_ps(pfRe + i), pr1 = _mm_loadu_ps(pfRe + i + 4), pr2 = _mm_loadu_ps(pfRe + i + 8), pr3 = _mm_loadu_ps(pfRe + i + 12);
+            __m128 pi0 = _mm_loadu_ps(pfIm + i), pi1 = _mm_loadu_ps(pfIm + i + 4), pi2 = _mm_loadu_ps(pfIm + i + 8), pi3 = _mm_loadu_ps(pfIm + i + 12);
+            _MM_TRANSPOSE4_PS(pr0, pr1, pr2, pr3);
+            _MM_TRANSPOSE4_PS(pi0, pi1, pi2, pi3);
+            __m128 r0 = _mm_add_ps(pr0, pr1), i0 = _mm_add_ps(pi0, pi1);
+            __m128 r1 = _mm_sub_ps(pr0, pr1), i1 = _mm_sub_ps(pi0, pi1);
+            __m128 r2 = _mm_add_ps(pr2, pr3), i2 = _mm_add_ps(pi2, pi3);
+            __m128 r3 = _mm_sub_ps(pr2, pr3), i3 = _mm_sub_ps(pi2, pi3);
+            pr0 = _mm_add_ps(r0, r2); pi0 = _mm_add_ps(i0, i2);
+            pr2 = _mm_sub_ps(r0, r2); pi2 = _mm_sub_ps(i0, i2);
+            pr1 = _mm_add_ps(r1, i3); pi1 = _mm_sub_ps(i1, r3);
+            pr3 = _mm_sub_ps(r1, i3); pi3 = _mm_add_ps(i1, r3);
+            _MM_TRANSPOSE4_PS(pr0, pr1, pr2, pr3);
+            _MM_TRANSPOSE4_PS(pi0, pi1, pi2, pi3);
+            _mm_storeu_ps(pfRe + i, pr0); _mm_storeu_ps(pfRe + i + 4, pr1); _mm_storeu_ps(pfRe + i + 8, pr2); _mm_storeu_ps(pfRe + i + 12, pr3);
+            _mm_storeu_ps(pfIm + i, pi0); _mm_storeu_ps(pfIm + i + 4, pi1); _mm_storeu_ps(pfIm + i + 8, pi2); _mm_storeu_ps(pfIm + i + 12, pi3);
+        }
+#endif
+        for (; i + 4 <= iHalf; i += 4) {
+            float r0 = pfRe[i] + pfRe[i + 1], i0 = pfIm[i] + pfIm[i + 1];
+            float r1 = pfRe[i] - pfRe[i + 1], i1 = pfIm[i] - pfIm[i + 1];
+            float r2 = pfRe[i + 2] + pfRe[i + 3], i2 = pfIm[i + 2] + pfIm[i + 3];
+            float r3 = pfRe[i + 2] - pfRe[i + 3], i3 = pfIm[i + 2] - pfIm[i + 3];
+            pfRe[i] = r0 + r2;     pfIm[i] = i0 + i2;
+            pfRe[i + 2] = r0 - r2; pfIm[i + 2] = i0 - i2;
+            pfRe[i + 1] = r1 + i3; pfIm[i + 1] = i1 - r3; // r3 + i i3 times -i
+            pfRe[i + 3] = r1 - i3; pfIm[i + 3] = i1 + r3;
+        }
+
+        for (int h = 4; h < iHalf; h *= 2)
+            for (int i = 0; i < iHalf; i += 2 * h)
+                simd::butterflies(pfRe + i, pfIm + i, pfRe + i + h, pfIm + i + h, &twiddleRe[h - 1], &twiddleIm[h - 1], h);
+    }
+
+    int iSize, iHalf;
+    std::vector<std::pair<int, int>> swaps; // into bit reversed order
+    std::vector<float> twiddleRe, twiddleIm; // per pass, for the half-length complex FFT
+    std::vector<float> splitRe, splitIm;     // e^(-2 pi i k / N), k = 0 .. N/2
+    std::vector<float> packedRe, packedIm;   // the packed half-length spectrum
+};
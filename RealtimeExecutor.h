@@ -0,0 +1,258 @@
+//
+//  RealtimeExecutor.h
+//  Multi-core Block Executor
+//
+//  Spreads the plugin instances of one audio callback across a fixed pool of worker threads.
+//  Work is given as chains: a chain is a list of jobs (e.g. the process() calls of the effects
+//  on one track) that must run in order, and different chains are independent. Chains are
+//  dealt out to the workers once, when the graph is built; on every block each worker takes
+//  chains from its own list and, when that runs dry, steals from the other lists. The calling
+//  (audio) thread works as well, as worker 0, and run() returns once every chain is done.
+//
+//  run() never allocates, locks or waits on a worker: a worker that is asleep or late simply
+//  leaves its chains to be stolen, so a block always completes even if every worker stalls.
+//  Workers spin for a short while after a block, then sleep until the next one.
+//
+//  Build the graph (addJob()) before the first run(); run() is for one thread at a time.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class RealtimeExecutor
+{
+public:
+    typedef void (*JobFunction)(void *pContext);
+
+    // iWorkers threads as well as the calling thread; bPin pins worker w to CPU w (the caller
+    // is expected to be on CPU 0) and asks for real-time priority where the system allows it
+    explicit RealtimeExecutor(int iWorkers, bool bPin = true)
+    : lists(iWorkers + 1), stats(iWorkers + 1), uGeneration(0), iRemaining(0), bQuit(false), iParked(0),
+      iBlocks(0), iDeadlineMisses(0), fWorstBlock(0)
+    {
+        // with more threads than cores a spinning worker only takes time from the one doing the work
+        iSpinLimit = iWorkers < (int)std::thread::hardware_concurrency() ? kSpinsBeforeSleep : 0;
+        for (int w = 1; w <= iWorkers; w++)
+            threads.emplace_back(&RealtimeExecutor::workerLoop, this, w, bPin);
+    }
+
+    ~RealtimeExecutor()
+    {
+        bQuit.store(true);
+        {
+            std::lock_guard<std::mutex> lock(parkMutex);
+            parked.notify_all();
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    int getNumWorkers() const { return (int)lists.size(); } // including the calling thread
+
+    // appends a job to chain iChain (chains are numbered from 0, in any order); returns iChain.
+    // Allocates: build the graph before processing starts.
+    int addJob(int iChain, JobFunction pfnJob, void *pContext)
+    {
+        if (iChain >= (int)chains.size()) {
+            chains.resize(iChain + 1);
+            // deal chains out round-robin, so each worker starts with its own share
+            for (WorkList& list : lists)
+                list.chains.clear();
+            for (int c = 0; c < (int)chains.size(); c++)
+                lists[c % lists.size()].chains.push_back(c);
+        }
+        chains[iChain].push_back({ pfnJob, pContext });
+        return iChain;
+    }
+
+    // runs every chain once and returns when all are done. dDeadline is the block's length in
+    // seconds: blocks that take longer count as deadline misses
+    void run(double dDeadline)
+    {
+        Clock::time_point start = Clock::now();
+
+        iRemaining.store((int)chains.size(), std::memory_order_relaxed);
+        for (WorkList& list : lists)
+            list.iNext.store(0, std::memory_order_release); // a worker still in the last block that takes one of these sees the new count
+        uGeneration.fetch_add(1, std::memory_order_release); // workers spinning on this start now
+
+        if (iParked.load(std::memory_order_relaxed) > 0)
+            parked.notify_all(); // no lock: a worker that misses this wakes on its timeout, and its chains get stolen meanwhile
+
+        work(0);
+        for (int iSpins = 0; iRemaining.load(std::memory_order_acquire) > 0; iSpins++) {
+            // another worker is finishing a chain it has already taken
+            if (iSpins < kSpinsBeforeYield)
+                pause();
+            else
+                std::this_thread::yield();
+        }
+
+        double dElapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        finishBlock(dElapsed, dDeadline);
+    }
+
+    // statistics, readable from any thread
+
+    // share of the block deadline worker w spent running jobs: smoothed over recent blocks, and the largest seen
+    float getWorkerLoad(int w) const { return stats[w].fLoad.load(std::memory_order_relaxed); }
+    float getWorkerPeakLoad(int w) const { return stats[w].fPeakLoad.load(std::memory_order_relaxed); }
+    uint64_t getBlocks() const { return iBlocks.load(std::memory_order_relaxed); }
+    uint64_t getDeadlineMisses() const { return iDeadlineMisses.load(std::memory_order_relaxed); }
+    float getWorstBlock() const { return fWorstBlock.load(std::memory_order_relaxed); } // as a share of its deadline
+
+    void resetStats()
+    {
+        for (WorkerStats& s : stats) {
+            s.fLoad.store(0);
+            s.fPeakLoad.store(0);
+        }
+        iBlocks.store(0);
+        iDeadlineMisses.store(0);
+        fWorstBlock.store(0);
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job { JobFunction pfnJob; void *pContext; };
+
+    struct alignas(64) WorkList {           // own cache line: every worker hammers its cursor
+        std::vector<int> chains;            // chains this worker starts with
+        std::atomic<int> iNext;             // next of them to take, by this worker or a thief
+        WorkList() : iNext(0) {}
+        WorkList(const WorkList& other) : chains(other.chains), iNext(0) {}
+    };
+
+    struct alignas(64) WorkerStats {
+        std::atomic<int64_t> iBusyNs;       // time spent in jobs during the current block
+        std::atomic<float> fLoad, fPeakLoad;
+        WorkerStats() : iBusyNs(0), fLoad(0), fPeakLoad(0) {}
+        WorkerStats(const WorkerStats&) : iBusyNs(0), fLoad(0), fPeakLoad(0) {}
+    };
+
+    static void pause()
+    {
+#if defined(__SSE2__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // takes and runs chains until none are left: own list first, then the others'
+    void work(int w)
+    {
+        int iWorkers = (int)lists.size();
+        int64_t iBusy = 0;
+
+        for (int v = 0; v < iWorkers; v++) {
+            WorkList& list = lists[(w + v) % iWorkers];
+            int iCount = (int)list.chains.size();
+            for (int i = list.iNext.fetch_add(1, std::memory_order_acq_rel); i < iCount;
+                 i = list.iNext.fetch_add(1, std::memory_order_acq_rel)) {
+                Clock::time_point start = Clock::now();
+                for (const Job& job : chains[list.chains[i]])
+                    job.pfnJob(job.pContext);
+                iBusy += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                iRemaining.fetch_sub(1, std::memory_order_acq_rel);
+            }
+        }
+        stats[w].iBusyNs.fetch_add(iBusy, std::memory_order_relaxed);
+    }
+
+    void workerLoop(int w, bool bPin)
+    {
+        if (bPin)
+            pinThread(w);
+
+        uint64_t uSeen = uGeneration.load(std::memory_order_acquire);
+        while (!bQuit.load(std::memory_order_relaxed)) {
+            // spin briefly for the next block, then sleep until woken (or the timeout, in case a wakeup was missed)
+            int iSpins = 0;
+            while (uGeneration.load(std::memory_order_acquire) == uSeen && !bQuit.load(std::memory_order_relaxed)) {
+                if (++iSpins < iSpinLimit) {
+                    pause();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(parkMutex);
+                iParked.fetch_add(1, std::memory_order_relaxed);
+                parked.wait_for(lock, std::chrono::milliseconds(1));
+                iParked.fetch_sub(1, std::memory_order_relaxed);
+                iSpins = 0;
+            }
+            uSeen = uGeneration.load(std::memory_order_acquire);
+            work(w);
+        }
+    }
+
+    static void pinThread(int w)
+    {
+#if defined(__linux__)
+        unsigned uCpus = std::thread::hardware_concurrency();
+        if (uCpus > 1) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(w % uCpus, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        sched_param param;
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); // needs the right privileges; stays at normal priority otherwise
+#endif
+    }
+
+    // per-worker load and deadline statistics for the block just finished
+    void finishBlock(double dElapsed, double dDeadline)
+    {
+        for (WorkerStats& s : stats) {
+            float fLoad = (float)(s.iBusyNs.exchange(0, std::memory_order_relaxed) * 1e-9 / dDeadline);
+            s.fLoad.store(s.fLoad.load(std::memory_order_relaxed) * 0.99f + fLoad * 0.01f, std::memory_order_relaxed);
+            if (fLoad > s.fPeakLoad.load(std::memory_order_relaxed))
+                s.fPeakLoad.store(fLoad, std::memory_order_relaxed);
+        }
+
+        float fBlock = (float)(dElapsed / dDeadline);
+        if (fBlock > fWorstBlock.load(std::memory_order_relaxed))
+            fWorstBlock.store(fBlock, std::memory_order_relaxed);
+        if (dElapsed > dDeadline)
+            iDeadlineMisses.fetch_add(1, std::memory_order_relaxed);
+        iBlocks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static const int kSpinsBeforeSleep = 20000; // roughly 0.1-1 ms of pause instructions
+    static const int kSpinsBeforeYield = 1000;  // the caller waiting on a chain another worker is running
+
+    std::vector<std::vector<Job>> chains;
+    std::vector<WorkList> lists;      // one per worker, [0] is the calling thread
+    std::vector<WorkerStats> stats;
+    std::vector<std::thread> threads;
+    int iSpinLimit;
+
+    std::atomic<uint64_t> uGeneration; // counts blocks: a change tells the workers to start
+    std::atomic<int> iRemaining;       // chains of this block not finished yet
+    std::atomic<bool> bQuit;
+    std::atomic<int> iParked;          // workers asleep on 'parked'
+    std::mutex parkMutex;
+    std::condition_variable parked;
+
+    std::atomic<uint64_t> iBlocks, iDeadlineMisses;
+    std::atomic<float> fWorstBlock;
+};
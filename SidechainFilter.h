@@ -0,0 +1,240 @@
+//
+//  SidechainFilter.h
+//  MyEffect Sidechain Filter
+//
+//  The filter in front of the gate detector. It lives as long as the plugin, so its state
+//  carries over between blocks, and only the filter type picked in the "Filter Type" menu is
+//  run. Coefficients are only recalculated when a cutoff, centre or width actually changes,
+//  and are then ramped to their new values over the next block (or a set number of samples,
+//  however many calls they take) to avoid zipper noise. A filter designed ahead of time (for a
+//  preset) can be taken over with load() without designing again.
+//
+
+#pragma once
+
+#include <cmath>
+
+class SidechainFilter
+{
+public:
+    enum Type { BANDPASS, LOWPASS, HIGHPASS }; // same order as the "Filter Type" menu
+
+    SidechainFilter()
+    : type(BANDPASS), fSampleRate(44100), fLowPassCutoff(200), fHighPassCutoff(1000), fCentre(200), fWidth(100),
+      bDirty(true), bRamp(false), iRampLength(0), iRampLeft(0), z1(0), z2(0)
+    {
+        current = target = Coefficients();
+    }
+
+    void setType(Type newType)
+    {
+        if (newType != type) {
+            type = newType;
+            bDirty = true;
+            bRamp = false; // a different response shape is not worth ramping towards, so jump
+            iRampLeft = 0;
+        }
+    }
+    Type getType() const { return type; }
+
+    void setSampleRate(float fRate) { change(fSampleRate, fRate, true); }
+    void setLowPass(float fCutoff) { change(fLowPassCutoff, fCutoff, type == LOWPASS); }
+    void setHighPass(float fCutoff) { change(fHighPassCutoff, fCutoff, type == HIGHPASS); }
+    void setBandPass(float fCentreHz, float fWidthHz)
+    {
+        change(fCentre, fCentreHz, type == BANDPASS);
+        change(fWidth, fWidthHz, type == BANDPASS);
+    }
+
+    // clears the filter memory (coefficients are kept)
+    void reset() { z1 = z2 = 0; }
+
+    // Ramps run over the next iSamples samples however the calls split them, or with 0 (the
+    // default) over the next call, whatever its length. A call must not run past the end of a
+    // ramp: the engines begin them at the start of an internal block and ramp over one.
+    void setRampLength(int iSamples) { iRampLength = iSamples; }
+
+    // ends any ramp at the new coefficients (while the filter is not being run, say)
+    void settle()
+    {
+        update();
+        current = target;
+        bRamp = false;
+        iRampLeft = 0;
+    }
+
+    struct Coefficients {
+        float b0, b1, b2, a1, a2; // normalised by a0
+
+        Coefficients() : b0(1), b1(0), b2(0), a1(0), a2(0) {}
+        Coefficients(float fB0, float fB1, float fB2, float fA1, float fA2) : b0(fB0), b1(fB1), b2(fB2), a1(fA1), a2(fA2) {}
+    };
+
+    // filters iCount samples from pfIn into pfOut (which may be the same buffer)
+    void process(const float *pfIn, float *pfOut, int iCount)
+    {
+        Coefficients c, delta;
+        float s1 = z1, s2 = z2; // state kept in registers for the loop
+
+        if (nextBlock(c, delta, iCount)) {
+            for (int i = 0; i < iCount; i++) {
+                c.b0 += delta.b0; c.b1 += delta.b1; c.b2 += delta.b2; c.a1 += delta.a1; c.a2 += delta.a2;
+                pfOut[i] = tick(pfIn[i], c, s1, s2);
+            }
+            endBlock(c);
+        }
+        else {
+            for (int i = 0; i < iCount; i++)
+                pfOut[i] = tick(pfIn[i], c, s1, s2);
+        }
+
+        z1 = flush(s1);
+        z2 = flush(s2);
+    }
+
+    // Coefficients for the next iCount samples, for code that runs the filter loop itself (the
+    // batch engine runs many at once): start is where they begin, and delta is added before each
+    // sample. Returns false, with delta all zero, unless a change is being ramped in; then the
+    // caller hands endBlock() the coefficients it reached.
+    bool nextBlock(Coefficients& start, Coefficients& delta, int iCount)
+    {
+        update();
+
+        start = current;
+        if (!bRamp) {
+            delta = Coefficients(0, 0, 0, 0, 0);
+            return false;
+        }
+
+        // step the coefficients linearly from where they were to the new design across the ramp
+        if (iRampLeft == 0) {
+            iRampLeft = iRampLength > 0 ? iRampLength : iCount;
+            float fStep = 1.0f / iRampLeft;
+            rampDelta = Coefficients(
+                (target.b0 - current.b0) * fStep, (target.b1 - current.b1) * fStep, (target.b2 - current.b2) * fStep,
+                (target.a1 - current.a1) * fStep, (target.a2 - current.a2) * fStep);
+        }
+        delta = rampDelta;
+        iRampLeft -= iCount;
+        if (iRampLeft <= 0) {
+            current = target;
+            bRamp = false;
+            iRampLeft = 0;
+        }
+        return true;
+    }
+
+    // where a ramp that carries on into the next call has got to (the last coefficients used)
+    void endBlock(const Coefficients& reached)
+    {
+        if (bRamp)
+            current = reached;
+    }
+
+    // designs the coefficients for the current settings now, if they are out of date (e.g. when
+    // preparing a preset off the audio thread, rather than in the next block)
+    void update()
+    {
+        if (bDirty) {
+            target = design();
+            if (!bRamp)
+                current = target;
+            iRampLeft = 0; // a ramp under way starts again from where it has got to
+            bDirty = false;
+        }
+    }
+
+    // the coefficients for the current settings (after update())
+    const Coefficients& getCoefficients() const { return target; }
+
+    // takes over the settings and coefficients of an update()d filter, keeping this one's state:
+    // ramped to over the next block, or jumped to if the filter type is different
+    void load(const SidechainFilter& designed)
+    {
+        bRamp = designed.type == type && !bDirty;
+        type = designed.type;
+        fSampleRate = designed.fSampleRate;
+        fLowPassCutoff = designed.fLowPassCutoff;
+        fHighPassCutoff = designed.fHighPassCutoff;
+        fCentre = designed.fCentre;
+        fWidth = designed.fWidth;
+        target = designed.target;
+        if (!bRamp)
+            current = target;
+        iRampLeft = 0;
+        bDirty = false;
+    }
+
+    // ramps to the given coefficients over the next block, leaving the settings as they are (for
+    // stepping between two designs; load() or a setter puts the filter back on its settings)
+    void rampTo(const Coefficients& coefficients)
+    {
+        update();
+        target = coefficients;
+        bRamp = true;
+        iRampLeft = 0;
+    }
+
+    // filter state this small (below -300 dB) is cleared, so it never decays into denormals
+    static float flush(float fState) { return fabsf(fState) < 1e-15f ? 0 : fState; }
+
+    // transposed direct form II
+    static float tick(float fIn, const Coefficients& c, float& s1, float& s2)
+    {
+        float fOut = c.b0 * fIn + s1;
+        s1 = c.b1 * fIn - c.a1 * fOut + s2;
+        s2 = c.b2 * fIn - c.a2 * fOut;
+        return fOut;
+    }
+
+private:
+    // marks the coefficients for recalculation if a setting really moved; bActive is false for
+    // settings of a filter type that is not selected (they are picked up when it is selected)
+    void change(float& fSetting, float fValue, bool bActive)
+    {
+        if (fValue == fSetting)
+            return;
+        fSetting = fValue;
+        if (bActive) {
+            bRamp = !bDirty || bRamp; // only ramp from coefficients that were actually in use
+            bDirty = true;
+        }
+    }
+
+    // RBJ cookbook designs: Butterworth low / high pass, constant 0 dB peak band pass
+    Coefficients design() const
+    {
+        double w, q;
+        switch (type) {
+            case LOWPASS:  w = omega(fLowPassCutoff); q = M_SQRT1_2; break;
+            case HIGHPASS: w = omega(fHighPassCutoff); q = M_SQRT1_2; break;
+            default:       w = omega(fCentre); q = fCentre / (fWidth < 1 ? 1 : fWidth); break;
+        }
+        double alpha = sin(w) / (2.0 * q), c = cos(w), a0 = 1.0 + alpha;
+        double b0, b1, b2;
+
+        switch (type) {
+            case LOWPASS:  b0 = (1 - c) / 2; b1 = 1 - c; b2 = b0; break;
+            case HIGHPASS: b0 = (1 + c) / 2; b1 = -(1 + c); b2 = b0; break;
+            default:       b0 = alpha; b1 = 0; b2 = -alpha; break;
+        }
+        return Coefficients((float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(-2 * c / a0), (float)((1 - alpha) / a0));
+    }
+
+    // clamps the frequency below Nyquist and converts it to radians per sample
+    double omega(float fFrequency) const
+    {
+        double dNyquist = 0.49 * fSampleRate;
+        double dFrequency = fFrequency < 1 ? 1 : (fFrequency > dNyquist ? dNyquist : fFrequency);
+        return 2.0 * M_PI * dFrequency / fSampleRate;
+    }
+
+    Type type;
+    float fSampleRate;
+    float fLowPassCutoff, fHighPassCutoff, fCentre, fWidth;
+    bool bDirty, bRamp;
+    int iRampLength, iRampLeft;      // samples a ramp takes (0: one call), and left of the one under way
+    Coefficients current, target;
+    Coefficients rampDelta;          // the step per sample of the ramp under way
+    float z1, z2;
+};
@@ -0,0 +1,458 @@
+//
+//  SimdKernels.h
+//  MyEffect Block Kernels
+//
+//  Block-wide building blocks for the gate engine. Each kernel has an AVX2 (8 floats)
+//  and SSE (4 floats) path, chosen at compile time, and a scalar loop for the remainder
+//  and for builds without either instruction set.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace simd {
+
+// pfOut = pfA + pfB (pfOut may be either input)
+inline void add(const float *pfA, const float *pfB, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_add_ps(_mm256_loadu_ps(pfA + i), _mm256_loadu_ps(pfB + i)));
+#elif defined(__SSE2__)
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_add_ps(_mm_loadu_ps(pfA + i), _mm_loadu_ps(pfB + i)));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = pfA[i] + pfB[i];
+}
+
+// returns the larger of fStart and the largest magnitude in pfIn
+inline float absMax(const float *pfIn, int iCount, float fStart)
+{
+    int i = 0;
+    float fMax = fStart;
+#if defined(__AVX2__)
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 max = _mm256_set1_ps(fStart);
+    for(; i + 8 <= iCount; i += 8)
+        max = _mm256_max_ps(max, _mm256_and_ps(_mm256_loadu_ps(pfIn + i), mask));
+    __m128 max4 = _mm_max_ps(_mm256_castps256_ps128(max), _mm256_extractf128_ps(max, 1));
+    max4 = _mm_max_ps(max4, _mm_movehl_ps(max4, max4));
+    max4 = _mm_max_ss(max4, _mm_shuffle_ps(max4, max4, 1));
+    fMax = _mm_cvtss_f32(max4);
+#elif defined(__SSE2__)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 max = _mm_set1_ps(fStart);
+    for(; i + 4 <= iCount; i += 4)
+        max = _mm_max_ps(max, _mm_and_ps(_mm_loadu_ps(pfIn + i), mask));
+    max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+    max = _mm_max_ss(max, _mm_shuffle_ps(max, max, 1));
+    fMax = _mm_cvtss_f32(max);
+#endif
+    for(; i < iCount; i++)
+        if(fabsf(pfIn[i]) > fMax)
+            fMax = fabsf(pfIn[i]);
+    return fMax;
+}
+
+// returns fStart plus the sum of the squares of pfIn
+inline float sumSquares(const float *pfIn, int iCount, float fStart)
+{
+    int i = 0;
+    float fSum = 0;
+#if defined(__AVX2__)
+    __m256 sum = _mm256_setzero_ps();
+    for(; i + 8 <= iCount; i += 8) {
+        __m256 x = _mm256_loadu_ps(pfIn + i);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(x, x));
+    }
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+    fSum = _mm_cvtss_f32(sum4);
+#elif defined(__SSE2__)
+    __m128 sum = _mm_setzero_ps();
+    for(; i + 4 <= iCount; i += 4) {
+        __m128 x = _mm_loadu_ps(pfIn + i);
+        sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    fSum = _mm_cvtss_f32(sum);
+#endif
+    for(; i < iCount; i++)
+        fSum += pfIn[i] * pfIn[i];
+    return fStart + fSum;
+}
+
+// The magnitude of a 4x polyphase oversampler's output: four FIR filters of iTaps taps each
+// (pfTaps, one phase after another) run over pfIn, which holds iTaps - 1 samples of history
+// followed by the iCount new ones, and pfOut[i] is the largest |output| of any phase at sample i.
+// Each input vector is loaded once for all four phases, whose sums run side by side so they
+// are not waiting on each other's adds (the sums for each output add up in the same order on
+// every path).
+inline void polyphasePeaks(const float *pfIn, const float *pfTaps, int iTaps, float *pfOut, int iCount)
+{
+    int i = 0;
+    const float *pfNewest = pfIn + iTaps - 1; // tap k of output i multiplies pfNewest[i - k]
+    const float *pfTaps0 = pfTaps, *pfTaps1 = pfTaps + iTaps, *pfTaps2 = pfTaps + 2 * iTaps, *pfTaps3 = pfTaps + 3 * iTaps;
+#if defined(__AVX2__)
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    for(; i + 8 <= iCount; i += 8) {
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for(int k = 0; k < iTaps; k++) {
+            __m256 x = _mm256_loadu_ps(pfNewest + i - k);
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_set1_ps(pfTaps0[k]), x));
+            sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_set1_ps(pfTaps1[k]), x));
+            sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(_mm256_set1_ps(pfTaps2[k]), x));
+            sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(_mm256_set1_ps(pfTaps3[k]), x));
+        }
+        __m256 peak = _mm256_max_ps(_mm256_and_ps(sum0, mask), _mm256_and_ps(sum1, mask));
+        peak = _mm256_max_ps(peak, _mm256_max_ps(_mm256_and_ps(sum2, mask), _mm256_and_ps(sum3, mask)));
+        _mm256_storeu_ps(pfOut + i, peak);
+    }
+#elif defined(__SSE2__)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for(; i + 4 <= iCount; i += 4) {
+        __m128 sum0 = _mm_setzero_ps(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for(int k = 0; k < iTaps; k++) {
+            __m128 x = _mm_loadu_ps(pfNewest + i - k);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_set1_ps(pfTaps0[k]), x));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_set1_ps(pfTaps1[k]), x));
+            sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_set1_ps(pfTaps2[k]), x));
+            sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_set1_ps(pfTaps3[k]), x));
+        }
+        __m128 peak = _mm_max_ps(_mm_and_ps(sum0, mask), _mm_and_ps(sum1, mask));
+        peak = _mm_max_ps(peak, _mm_max_ps(_mm_and_ps(sum2, mask), _mm_and_ps(sum3, mask)));
+        _mm_storeu_ps(pfOut + i, peak);
+    }
+#endif
+    for(; i < iCount; i++) {
+        float fSum0 = 0, fSum1 = 0, fSum2 = 0, fSum3 = 0;
+        for(int k = 0; k < iTaps; k++) {
+            fSum0 += pfTaps0[k] * pfNewest[i - k];
+            fSum1 += pfTaps1[k] * pfNewest[i - k];
+            fSum2 += pfTaps2[k] * pfNewest[i - k];
+            fSum3 += pfTaps3[k] * pfNewest[i - k];
+        }
+        float fPeak = fabsf(fSum0) > fabsf(fSum1) ? fabsf(fSum0) : fabsf(fSum1);
+        fPeak = fabsf(fSum2) > fPeak ? fabsf(fSum2) : fPeak;
+        pfOut[i] = fabsf(fSum3) > fPeak ? fabsf(fSum3) : fPeak;
+    }
+}
+
+// pfOut = (pfIn * pfGain) * fScale
+inline void applyGain(const float *pfIn, const float *pfGain, float fScale, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(fScale);
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(pfIn + i), _mm256_loadu_ps(pfGain + i)), scale));
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(fScale);
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(pfIn + i), _mm_loadu_ps(pfGain + i)), scale));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = (pfIn[i] * pfGain[i]) * fScale;
+}
+
+// pfOut = pfDry + pfWet * fWetGain
+inline void mixOutput(const float *pfDry, const float *pfWet, float fWetGain, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 wet = _mm256_set1_ps(fWetGain);
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_add_ps(_mm256_loadu_ps(pfDry + i), _mm256_mul_ps(_mm256_loadu_ps(pfWet + i), wet)));
+#elif defined(__SSE2__)
+    const __m128 wet = _mm_set1_ps(fWetGain);
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_add_ps(_mm_loadu_ps(pfDry + i), _mm_mul_ps(_mm_loadu_ps(pfWet + i), wet)));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = pfDry[i] + pfWet[i] * fWetGain;
+}
+
+// pfOut = pfA * pfB (pfOut may be either input)
+inline void multiply(const float *pfA, const float *pfB, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_mul_ps(_mm256_loadu_ps(pfA + i), _mm256_loadu_ps(pfB + i)));
+#elif defined(__SSE2__)
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_mul_ps(_mm_loadu_ps(pfA + i), _mm_loadu_ps(pfB + i)));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = pfA[i] * pfB[i];
+}
+
+// pfOut = pfA + pfB * pfC
+inline void multiplyAdd(const float *pfA, const float *pfB, const float *pfC, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_add_ps(_mm256_loadu_ps(pfA + i), _mm256_mul_ps(_mm256_loadu_ps(pfB + i), _mm256_loadu_ps(pfC + i))));
+#elif defined(__SSE2__)
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_add_ps(_mm_loadu_ps(pfA + i), _mm_mul_ps(_mm_loadu_ps(pfB + i), _mm_loadu_ps(pfC + i))));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = pfA[i] + pfB[i] * pfC[i];
+}
+
+// pfOut = pfIn * fGain
+inline void scale(const float *pfIn, float fGain, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 gain = _mm256_set1_ps(fGain);
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_mul_ps(_mm256_loadu_ps(pfIn + i), gain));
+#elif defined(__SSE2__)
+    const __m128 gain = _mm_set1_ps(fGain);
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_mul_ps(_mm_loadu_ps(pfIn + i), gain));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = pfIn[i] * fGain;
+}
+
+// pfOut = (pfA + pfB) * 0.5
+inline void average(const float *pfA, const float *pfB, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 half = _mm256_set1_ps(0.5f);
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(pfA + i), _mm256_loadu_ps(pfB + i)), half));
+#elif defined(__SSE2__)
+    const __m128 half = _mm_set1_ps(0.5f);
+    for(; i + 4 <= iCount; i += 4)
+        _mm_storeu_ps(pfOut + i, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(pfA + i), _mm_loadu_ps(pfB + i)), half));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = (pfA[i] + pfB[i]) * 0.5f;
+}
+
+// the index of the first value in pfIn whose magnitude is at least fLevel, or iCount if none is
+inline int firstReaching(const float *pfIn, int iCount, float fLevel)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)), level = _mm256_set1_ps(fLevel);
+    for(; i + 8 <= iCount; i += 8) {
+        int iBits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(pfIn + i), mask), level, _CMP_GE_OQ));
+        if (iBits)
+            return i + __builtin_ctz(iBits);
+    }
+#elif defined(__SSE2__)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)), level = _mm_set1_ps(fLevel);
+    for(; i + 4 <= iCount; i += 4) {
+        int iBits = _mm_movemask_ps(_mm_cmpge_ps(_mm_and_ps(_mm_loadu_ps(pfIn + i), mask), level));
+        if (iBits)
+            return i + __builtin_ctz(iBits);
+    }
+#endif
+    for(; i < iCount; i++)
+        if (fabsf(pfIn[i]) >= fLevel)
+            return i;
+    return iCount;
+}
+
+// the index of the last value in pfIn whose magnitude is at least fLevel, or -1 if none is
+inline int lastReaching(const float *pfIn, int iCount, float fLevel)
+{
+    int i = iCount;
+#if defined(__AVX2__)
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)), level = _mm256_set1_ps(fLevel);
+    for(; i - 8 >= 0; i -= 8) {
+        int iBits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(pfIn + i - 8), mask), level, _CMP_GE_OQ));
+        if (iBits)
+            return i - 8 + 31 - __builtin_clz(iBits);
+    }
+#elif defined(__SSE2__)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)), level = _mm_set1_ps(fLevel);
+    for(; i - 4 >= 0; i -= 4) {
+        int iBits = _mm_movemask_ps(_mm_cmpge_ps(_mm_and_ps(_mm_loadu_ps(pfIn + i - 4), mask), level));
+        if (iBits)
+            return i - 4 + 31 - __builtin_clz(iBits);
+    }
+#endif
+    for(i--; i >= 0; i--)
+        if (fabsf(pfIn[i]) >= fLevel)
+            return i;
+    return -1;
+}
+
+// pfOut = pfIn, with every value whose magnitude is below fLevel set to 0 (pfOut may be pfIn)
+inline void zeroBelow(const float *pfIn, float fLevel, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)), level = _mm256_set1_ps(fLevel);
+    for(; i + 8 <= iCount; i += 8) {
+        __m256 in = _mm256_loadu_ps(pfIn + i);
+        _mm256_storeu_ps(pfOut + i, _mm256_and_ps(in, _mm256_cmp_ps(_mm256_and_ps(in, mask), level, _CMP_GE_OQ)));
+    }
+#elif defined(__SSE2__)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)), level = _mm_set1_ps(fLevel);
+    for(; i + 4 <= iCount; i += 4) {
+        __m128 in = _mm_loadu_ps(pfIn + i);
+        _mm_storeu_ps(pfOut + i, _mm_and_ps(in, _mm_cmpge_ps(_mm_and_ps(in, mask), level)));
+    }
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = fabsf(pfIn[i]) >= fLevel ? pfIn[i] : 0;
+}
+
+// counts the values in pfIn that are greater than fLevel
+inline int countAbove(const float *pfIn, int iCount, float fLevel)
+{
+    int i = 0, iAbove = 0;
+#if defined(__AVX2__)
+    const __m256 level = _mm256_set1_ps(fLevel);
+    for(; i + 8 <= iCount; i += 8)
+        iAbove += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(pfIn + i), level, _CMP_GT_OQ)));
+#elif defined(__SSE2__)
+    const __m128 level = _mm_set1_ps(fLevel);
+    for(; i + 4 <= iCount; i += 4)
+        iAbove += __builtin_popcount(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(pfIn + i), level)));
+#endif
+    for(; i < iCount; i++)
+        iAbove += pfIn[i] > fLevel;
+    return iAbove;
+}
+
+// Radix-2 FFT butterflies on split complex arrays: with t = B * W, B = A - t and A = A + t
+inline void butterflies(float *pfReA, float *pfImA, float *pfReB, float *pfImB, const float *pfWr, const float *pfWi, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= iCount; i += 8) {
+        __m256 br = _mm256_loadu_ps(pfReB + i), bi = _mm256_loadu_ps(pfImB + i);
+        __m256 wr = _mm256_loadu_ps(pfWr + i), wi = _mm256_loadu_ps(pfWi + i);
+        __m256 tr = _mm256_sub_ps(_mm256_mul_ps(br, wr), _mm256_mul_ps(bi, wi));
+        __m256 ti = _mm256_add_ps(_mm256_mul_ps(br, wi), _mm256_mul_ps(bi, wr));
+        __m256 ar = _mm256_loadu_ps(pfReA + i), ai = _mm256_loadu_ps(pfImA + i);
+        _mm256_storeu_ps(pfReB + i, _mm256_sub_ps(ar, tr));
+        _mm256_storeu_ps(pfImB + i, _mm256_sub_ps(ai, ti));
+        _mm256_storeu_ps(pfReA + i, _mm256_add_ps(ar, tr));
+        _mm256_storeu_ps(pfImA + i, _mm256_add_ps(ai, ti));
+    }
+#endif
+#if defined(__SSE2__)
+    for(; i + 4 <= iCount; i += 4) { // also the 4-point passes of an AVX2 build
+        __m128 br = _mm_loadu_ps(pfReB + i), bi = _mm_loadu_ps(pfImB + i);
+        __m128 wr = _mm_loadu_ps(pfWr + i), wi = _mm_loadu_ps(pfWi + i);
+        __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+        __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+        __m128 ar = _mm_loadu_ps(pfReA + i), ai = _mm_loadu_ps(pfImA + i);
+        _mm_storeu_ps(pfReB + i, _mm_sub_ps(ar, tr));
+        _mm_storeu_ps(pfImB + i, _mm_sub_ps(ai, ti));
+        _mm_storeu_ps(pfReA + i, _mm_add_ps(ar, tr));
+        _mm_storeu_ps(pfImA + i, _mm_add_ps(ai, ti));
+    }
+#endif
+    for(; i < iCount; i++) {
+        float tr = pfReB[i] * pfWr[i] - pfImB[i] * pfWi[i];
+        float ti = pfReB[i] * pfWi[i] + pfImB[i] * pfWr[i];
+        pfReB[i] = pfReA[i] - tr;
+        pfImB[i] = pfImA[i] - ti;
+        pfReA[i] += tr;
+        pfImA[i] += ti;
+    }
+}
+
+// IEEE half precision (float16) to and from float, rounding to nearest even as the F16C
+// instructions do, so builds with and without them store the same bits. Halves keep 11
+// significant bits (about 66 dB below each sample) and reach down to 6e-8 (-144 dBFS).
+inline uint16_t toHalf(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    uint32_t uSign = (u >> 16) & 0x8000;
+    u &= 0x7FFFFFFF;
+
+    if (u >= 0x7F800000) // infinity or NaN
+        return (uint16_t)(uSign | (u > 0x7F800000 ? 0x7E00 | ((u >> 13) & 0x3FF) : 0x7C00));
+    if (u >= 0x477FF000) // rounds past the largest half (65504)
+        return (uint16_t)(uSign | 0x7C00);
+    if (u < 0x38800000) {
+        //below the smallest normal half: adding 0.5 lines the half's subnormal bits up at the
+        //bottom of the float's mantissa, and the addition rounds them
+        float fShifted;
+        memcpy(&fShifted, &u, sizeof(u));
+        fShifted += 0.5f;
+        memcpy(&u, &fShifted, sizeof(u));
+        return (uint16_t)(uSign | (u - 0x3F000000));
+    }
+    //rebias the exponent and round the 13 bits dropped from the mantissa to nearest even
+    u += 0xC8000FFF + ((u >> 13) & 1);
+    return (uint16_t)(uSign | (u >> 13));
+}
+
+inline float fromHalf(uint16_t h)
+{
+    uint32_t u = (uint32_t)(h & 0x7FFF) << 13;
+    uint32_t uExponent = u & 0x0F800000;
+    u += (127 - 15) << 23;
+    float f;
+    if (uExponent == 0x0F800000) // infinity or NaN
+        u += (128 - 16) << 23;
+    else if (uExponent == 0) { // subnormal: let the float subtraction normalise it
+        u += 1 << 23;
+        memcpy(&f, &u, sizeof(u));
+        f -= 6.103515625e-05f; // 2^-14
+        memcpy(&u, &f, sizeof(u));
+    }
+    u |= (uint32_t)(h & 0x8000) << 16;
+    memcpy(&f, &u, sizeof(u));
+    return f;
+}
+
+// puOut = pfIn as halves
+inline void toHalf(const float *pfIn, uint16_t *puOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    for(; i + 8 <= iCount; i += 8)
+        _mm_storeu_si128((__m128i*)(puOut + i), _mm256_cvtps_ph(_mm256_loadu_ps(pfIn + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for(; i < iCount; i++)
+        puOut[i] = toHalf(pfIn[i]);
+}
+
+// pfOut = puIn as floats
+inline void fromHalf(const uint16_t *puIn, float *pfOut, int iCount)
+{
+    int i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    for(; i + 8 <= iCount; i += 8)
+        _mm256_storeu_ps(pfOut + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(puIn + i))));
+#endif
+    for(; i < iCount; i++)
+        pfOut[i] = fromHalf(puIn[i]);
+}
+
+inline void fill(float *pfOut, float fValue, int iCount)
+{
+    for(int i = 0; i < iCount; i++)
+        pfOut[i] = fValue;
+}
+
+} // namespace simd
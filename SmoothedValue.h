@@ -0,0 +1,85 @@
+//
+//  SmoothedValue.h
+//  MyEffect Parameter Smoothing
+//
+//  Glides a gain-like value to a new target over a number of samples instead of jumping, so a
+//  control moved during playback does not click. LINEAR reaches the target in exactly the
+//  ramp time; EXPONENTIAL is a one-pole glide with that time constant, which sounds more even
+//  for feedback amounts and snaps to the target once it is within 1e-5 of it. The first target
+//  set is jumped to, as there is nothing to glide from.
+//
+
+#pragma once
+
+#include <cmath>
+
+class SmoothedValue
+{
+public:
+    enum Shape { LINEAR, EXPONENTIAL };
+
+    explicit SmoothedValue(Shape newShape = LINEAR)
+    : shape(newShape), iTime(1), fValue(0), fTarget(0), fStep(0), fCoefficient(0), iRampLeft(0), bSet(false) {}
+
+    // ramp length (LINEAR) or time constant (EXPONENTIAL) in samples; applies to the next target
+    void setTime(int iSamples)
+    {
+        iTime = iSamples < 1 ? 1 : iSamples;
+        fCoefficient = expf(-1.0f / iTime);
+    }
+
+    void setTarget(float fNewTarget)
+    {
+        if (fNewTarget == fTarget && bSet)
+            return;
+        fTarget = fNewTarget;
+        if (!bSet) {
+            fValue = fTarget;
+            bSet = true;
+            return;
+        }
+        iRampLeft = iTime;
+        fStep = (fTarget - fValue) / iTime;
+    }
+
+    // ends any glide at its target
+    void reset()
+    {
+        fValue = fTarget;
+        iRampLeft = 0;
+    }
+
+    bool isRamping() const { return iRampLeft > 0; }
+    float getValue() const { return fValue; } // the target, when not ramping
+
+    // the next iCount per-sample values
+    void process(float *pfOut, int iCount)
+    {
+        int i = 0;
+        if (shape == LINEAR) {
+            for (; i < iCount && iRampLeft > 0; i++, iRampLeft--)
+                pfOut[i] = fValue += fStep;
+            if (iRampLeft == 0)
+                fValue = fTarget; // land exactly, whatever rounding the steps picked up
+        }
+        else {
+            for (; i < iCount && iRampLeft > 0; i++) {
+                fValue = fTarget + (fValue - fTarget) * fCoefficient;
+                if (fabsf(fValue - fTarget) < 1e-5f) {
+                    fValue = fTarget;
+                    iRampLeft = 0;
+                }
+                pfOut[i] = fValue;
+            }
+        }
+        for (; i < iCount; i++)
+            pfOut[i] = fValue;
+    }
+
+private:
+    Shape shape;
+    int iTime;
+    float fValue, fTarget, fStep, fCoefficient;
+    int iRampLeft;  // LINEAR: samples to go; EXPONENTIAL: non-zero until the target is reached
+    bool bSet;
+};
@@ -0,0 +1,206 @@
+//
+//  SpectralGate.h
+//  MyEffect Spectral (Multiband) Gate
+//
+//  The "Multiband" gate: splits each channel into kBands bands with a short-time FFT and runs
+//  the threshold, hysteresis, hold and reduction logic on every band separately, so noise in
+//  the bands nobody is speaking in stays down while the others open. Frames of about 10 ms
+//  (a power of two, 512 samples at 44.1 / 48 kHz) overlap by half, with a square-root Hann
+//  window both before the FFT and after the inverse, so with every band open the output is the
+//  input delayed by one frame. Bands are about half an octave wide, from one bin at the bottom
+//  to many at the top.
+//
+//  A band's level is the RMS of its part of the frame, scaled so a sine at the threshold opens
+//  its band as it would open the broadband gate. Once per frame every band's envelope takes one
+//  GateEnvelope step covering the whole hop, with coefficients made from the broadband gate's.
+//  Linked,
+//  one set of band gains keys from the mean band energy of all channels and is applied to
+//  every channel; unlinked, each channel has its own.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "GateEnvelope.h"
+#include "RealFFT.h"
+#include "SimdKernels.h"
+
+// everything that does not depend on the channel count
+struct SpectralGateBase
+{
+    static const int kBands = 16;
+
+    // frame length at a sample rate: the power of two nearest above 10 ms
+    static int frameLength(float fSampleRate)
+    {
+        int iLength = 256;
+        while (iLength < 0.01 * fSampleRate)
+            iLength *= 2;
+        return iLength;
+    }
+
+    // how far the output runs behind the input: a sample's output is finished by the frame after
+    // the one it came in with, and goes out during the hop after that
+    static int latencySamples(float fSampleRate) { return frameLength(fSampleRate); }
+
+    // the gate levels (linear) and ballistics, per sample as GateEngine has them
+    struct Levels {
+        float fOpen, fClose, fFloor;
+        float fAttack, fRelease, fHoldLength;
+    };
+};
+
+template <int Channels>
+class SpectralGate : public SpectralGateBase
+{
+public:
+    SpectralGate() : iLength(0), iHop(0), iBins(0), iFill(0), fSampleAttack(NAN), fSampleRelease(NAN), fFrameAttack(1), fFrameRelease(1) {}
+
+    // sizes the frames for a sample rate (allocates: not for the audio thread)
+    void prepare(float fSampleRate)
+    {
+        iLength = frameLength(fSampleRate);
+        iHop = iLength / 2;
+        fft.setSize(iLength);
+        iBins = fft.getBins();
+
+        window.assign(iLength, 0.f);
+        for (int i = 0; i < iLength; i++)
+            window[i] = (float)sin(M_PI * i / iLength); //square root of a periodic Hann window
+
+        //band edges at powers of the bin count, at least one bin wide
+        piBandStart[0] = 0;
+        for (int b = 1; b < kBands; b++) {
+            int iEdge = (int)lround(pow((double)iBins, (double)b / kBands));
+            piBandStart[b] = iEdge > piBandStart[b - 1] ? iEdge : piBandStart[b - 1] + 1;
+        }
+        piBandStart[kBands] = iBins;
+
+        frame.assign(iLength, 0.f);
+        binGain.assign(iBins, 0.f);
+        for (int c = 0; c < Channels; c++) {
+            input[c].assign(iLength, 0.f);
+            output[c].assign(iLength, 0.f);
+            spectrumRe[c].assign(iBins, 0.f);
+            spectrumIm[c].assign(iBins, 0.f);
+        }
+        reset();
+    }
+
+    // back to silence, with every band closed (no allocation)
+    void reset()
+    {
+        for (int c = 0; c < Channels; c++) {
+            std::fill(input[c].begin(), input[c].end(), 0.f);
+            std::fill(output[c].begin(), output[c].end(), 0.f);
+            for (int b = 0; b < kBands; b++) {
+                ppfBandGain[c][b] = ppfBandEnvelope[c][b] = ppfBandHold[c][b] = 0;
+                ppiBandStage[c][b] = GateEnvelope::CLOSED;
+            }
+        }
+        iFill = iLength - iHop;
+    }
+
+    // the mean of a channel's band gains in the last frame (for the meters)
+    float getGain(int iChannel, bool bLinked) const
+    {
+        const float *pfGain = ppfBandGain[bLinked ? 0 : iChannel];
+        float fSum = 0;
+        for (int b = 0; b < kBands; b++)
+            fSum += pfGain[b];
+        return fSum / kBands;
+    }
+
+    // Gates iCount samples of every channel from ppIn into ppOut (a frame later). A frame
+    // is analysed, gated and added back each time another hop of input has come in.
+    void process(const float* const* ppIn, float* const* ppOut, int iCount, const Levels& levels, bool bLinked)
+    {
+        for (int iDone = 0; iDone < iCount; )
+        {
+            int iRun = iLength - iFill;
+            if (iRun > iCount - iDone) iRun = iCount - iDone;
+
+            //the input goes in behind the last frame's, the output comes from the hop already finished
+            for (int c = 0; c < Channels; c++) {
+                memcpy(&input[c][iFill], ppIn[c] + iDone, iRun * sizeof(float));
+                memcpy(ppOut[c] + iDone, &output[c][iFill - (iLength - iHop)], iRun * sizeof(float));
+            }
+            iFill += iRun;
+            iDone += iRun;
+
+            if (iFill == iLength) {
+                processFrame(levels, bLinked);
+                iFill = iLength - iHop;
+            }
+        }
+    }
+
+private:
+    void processFrame(const Levels& levels, bool bLinked)
+    {
+        for (int c = 0; c < Channels; c++) {
+            simd::multiply(input[c].data(), window.data(), frame.data(), iLength);
+            fft.forward(frame.data(), spectrumRe[c].data(), spectrumIm[c].data());
+            memmove(input[c].data(), &input[c][iHop], (iLength - iHop) * sizeof(float));
+        }
+
+        //a step per frame moves the envelopes as far as a step per sample would over a hop
+        if (levels.fAttack != fSampleAttack || levels.fRelease != fSampleRelease) {
+            fSampleAttack = levels.fAttack;
+            fSampleRelease = levels.fRelease;
+            fFrameAttack = GateEnvelope::coefficient(fSampleAttack, iHop);
+            fFrameRelease = GateEnvelope::coefficient(fSampleRelease, iHop);
+        }
+
+        //RMS of a band over the frame, times sqrt 2 (a sine's peak): sqrt(8 * energy) / N
+        float fScale = 8.0f / ((float)iLength * iLength) / (bLinked ? Channels : 1);
+        for (int g = 0; g < (bLinked ? 1 : Channels); g++) {
+            for (int b = 0; b < kBands; b++) {
+                int iStart = piBandStart[b], iBandBins = piBandStart[b + 1] - piBandStart[b];
+                float fEnergy = 0;
+                for (int c = bLinked ? 0 : g; c < (bLinked ? Channels : g + 1); c++) {
+                    fEnergy = simd::sumSquares(&spectrumRe[c][iStart], iBandBins, fEnergy);
+                    fEnergy = simd::sumSquares(&spectrumIm[c][iStart], iBandBins, fEnergy);
+                }
+                GateEnvelope::step(sqrtf(fEnergy * fScale), levels.fOpen, levels.fClose, fFrameAttack, fFrameRelease,
+                                   levels.fHoldLength, (float)iHop, ppfBandEnvelope[g][b], ppfBandHold[g][b], ppiBandStage[g][b]);
+                ppfBandGain[g][b] = GateEnvelope::gain(levels.fFloor, ppfBandEnvelope[g][b]);
+            }
+        }
+
+        for (int c = 0; c < Channels; c++) {
+            if (c == 0 || !bLinked) {
+                const float *pfGain = ppfBandGain[bLinked ? 0 : c];
+                for (int b = 0; b < kBands; b++)
+                    simd::fill(&binGain[piBandStart[b]], pfGain[b], piBandStart[b + 1] - piBandStart[b]);
+            }
+            simd::multiply(spectrumRe[c].data(), binGain.data(), spectrumRe[c].data(), iBins);
+            simd::multiply(spectrumIm[c].data(), binGain.data(), spectrumIm[c].data(), iBins);
+            fft.inverse(spectrumRe[c].data(), spectrumIm[c].data(), frame.data());
+
+            //windowed again and added to the overlap, whose first hop is then finished
+            float *pfOutput = output[c].data();
+            memmove(pfOutput, pfOutput + iHop, (iLength - iHop) * sizeof(float));
+            simd::fill(pfOutput + (iLength - iHop), 0, iHop);
+            simd::multiplyAdd(pfOutput, frame.data(), window.data(), pfOutput, iLength);
+        }
+    }
+
+    int iLength, iHop, iBins;
+    int iFill; // samples of the next frame in input[] (the output going out with the next is at iFill - (iLength - iHop))
+    RealFFT fft;
+    std::vector<float> window, frame, binGain;
+    int piBandStart[kBands + 1]; // first bin of each band, and the bin count at the end
+
+    std::vector<float> input[Channels];  // the frame being filled
+    std::vector<float> output[Channels]; // overlap-add: the first hop is ready, the rest still has a frame to come
+    std::vector<float> spectrumRe[Channels], spectrumIm[Channels];
+    float fSampleAttack, fSampleRelease; // the gate's coefficients per sample,
+    float fFrameAttack, fFrameRelease;   // and per frame
+    float ppfBandGain[Channels][kBands], ppfBandEnvelope[Channels][kBands], ppfBandHold[Channels][kBands]; // linked uses [0]
+    int ppiBandStage[Channels][kBands];
+};
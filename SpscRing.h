@@ -0,0 +1,56 @@
+//
+//  SpscRing.h
+//  MyEffect Single-Producer Single-Consumer Ring
+//
+//  A fixed-capacity FIFO between exactly one writing thread and one reading thread. Both
+//  sides are wait-free: push() and pop() each do one atomic load and one atomic store and never
+//  block, so the audio thread can hand data to another thread without locks or allocation.
+//  When the ring is full, push() drops the item and counts it, rather than waiting.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T, int Capacity>
+class SpscRing
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscRing() : uWrite(0), uRead(0), uDropped(0) {}
+
+    // producer side: false (and the item is counted as dropped) if the consumer has fallen a whole ring behind
+    bool push(const T& item)
+    {
+        uint32_t uAt = uWrite.load(std::memory_order_relaxed);
+        if (uAt - uRead.load(std::memory_order_acquire) == (uint32_t)Capacity) {
+            uDropped.store(uDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        items[uAt & (Capacity - 1)] = item;
+        uWrite.store(uAt + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side: false if there is nothing waiting
+    bool pop(T& item)
+    {
+        uint32_t uAt = uRead.load(std::memory_order_relaxed);
+        if (uAt == uWrite.load(std::memory_order_acquire))
+            return false;
+        item = items[uAt & (Capacity - 1)];
+        uRead.store(uAt + 1, std::memory_order_release);
+        return true;
+    }
+
+    // items dropped because the ring was full (any thread)
+    uint32_t getDropped() const { return uDropped.load(std::memory_order_relaxed); }
+
+private:
+    T items[Capacity];
+    alignas(64) std::atomic<uint32_t> uWrite;   // own cache lines, so the two sides do not share one
+    alignas(64) std::atomic<uint32_t> uRead;
+    std::atomic<uint32_t> uDropped;
+};
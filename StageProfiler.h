@@ -0,0 +1,201 @@
+//
+//  StageProfiler.h
+//  MyEffect Stage Profiler
+//
+//  Optional timing of each stage of process() with the CPU's cycle counter. Built with
+//  MYEFFECT_PROFILE defined, the PROFILE_STAGE() scopes in the engine add the cycles spent in
+//  each stage to a per-call total, and endBlock() files those totals (and the whole call) into
+//  log2 histograms, keeps the worst, and counts calls that ran past their real-time deadline.
+//  Without it, PROFILE_STAGE() compiles to nothing and the counters stay at zero.
+//
+//  Only the audio thread writes; every counter is an atomic it stores with a plain
+//  load-and-store, so another thread can read them at any time without stopping the audio.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+class StageProfiler
+{
+public:
+    enum Stage {
+        SIDECHAIN,  // sidechain filter (and the linked key mix)
+        DETECTOR,   // sliding peak over the detector window
+        GATE,       // gate envelope
+        METERS,     // meter measurement and telemetry
+        DELAY,      // echo and lookahead lines
+        MIX,        // gate gain and output mix
+        CONVERT,    // integer PCM in and out (processPcm() only)
+        NUM_STAGES
+    };
+    static const int kBuckets = 32; // bucket b counts times of [2^b, 2^(b+1)) cycles
+
+    StageProfiler()
+    {
+#if defined(MYEFFECT_PROFILE)
+        dCyclesPerSecond = cyclesPerSecond(); // calibrated here, never on the audio thread
+#else
+        dCyclesPerSecond = 1;
+#endif
+        clear();
+    }
+
+    static const char* stageName(int iStage)
+    {
+        static const char* const names[NUM_STAGES] = { "sidechain", "detector", "gate", "meters", "delay", "mix", "convert" };
+        return iStage < NUM_STAGES ? names[iStage] : "block";
+    }
+
+    // the cycle counter: TSC on x86, the virtual counter on AArch64, nanoseconds elsewhere
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t uTicks;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(uTicks));
+        return uTicks;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // counter ticks per second, measured against the steady clock the first time it is asked for (takes 20 ms)
+    static double cyclesPerSecond()
+    {
+        static const double dRate = []() {
+            typedef std::chrono::steady_clock Clock;
+            Clock::time_point start = Clock::now();
+            uint64_t uStart = now();
+            while (Clock::now() - start < std::chrono::milliseconds(20)) {}
+            double dSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            return (now() - uStart) / dSeconds;
+        }();
+        return dRate;
+    }
+
+    // times one stage from construction to destruction
+    class Scope
+    {
+    public:
+        Scope(StageProfiler& newProfiler, Stage newStage) : profiler(newProfiler), stage(newStage), uStart(now()) {}
+        ~Scope() { profiler.add(stage, now() - uStart); }
+    private:
+        StageProfiler& profiler;
+        Stage stage;
+        uint64_t uStart;
+    };
+
+    // audio thread: brackets one process() call of iCount samples at fSampleRate
+    void beginBlock()
+    {
+        if (bClear.load(std::memory_order_acquire)) {
+            clear();
+            bClear.store(false, std::memory_order_release);
+        }
+        for (int s = 0; s < NUM_STAGES; s++)
+            puBlockCycles[s] = 0;
+        uBlockStart = now();
+    }
+    void add(Stage stage, uint64_t uCycles) { puBlockCycles[stage] += uCycles; }
+    void endBlock(int iCount, float fSampleRate)
+    {
+        uint64_t uBlock = now() - uBlockStart;
+        for (int s = 0; s < NUM_STAGES; s++)
+            record(s, puBlockCycles[s]);
+        record(NUM_STAGES, uBlock);
+
+        if (uBlock > iCount / fSampleRate * dCyclesPerSecond)
+            bump(uMisses);
+        bump(uBlocks);
+        if (uBlock > uWorstBlock.load(std::memory_order_relaxed)) {
+            uWorstBlock.store(uBlock, std::memory_order_relaxed);
+            iWorstBlockSamples.store(iCount, std::memory_order_relaxed);
+            fWorstBlockRate.store(fSampleRate, std::memory_order_relaxed);
+        }
+    }
+
+    // any thread: stage NUM_STAGES is the whole process() call
+    uint64_t getBlocks() const { return uBlocks.load(std::memory_order_relaxed); }
+    uint64_t getDeadlineMisses() const { return uMisses.load(std::memory_order_relaxed); }
+    uint64_t getTotalCycles(int iStage) const { return puTotal[iStage].load(std::memory_order_relaxed); }
+    uint64_t getWorstCycles(int iStage) const { return puWorst[iStage].load(std::memory_order_relaxed); }
+    uint64_t getHistogram(int iStage, int iBucket) const { return ppuHistogram[iStage][iBucket].load(std::memory_order_relaxed); }
+
+    // the slowest process() call as a fraction of its deadline (1 = used all of it)
+    double getWorstBlockLoad() const
+    {
+        float fRate = fWorstBlockRate.load(std::memory_order_relaxed);
+        int iSamples = iWorstBlockSamples.load(std::memory_order_relaxed);
+        if (iSamples == 0 || fRate == 0)
+            return 0;
+        return uWorstBlock.load(std::memory_order_relaxed) / (iSamples / fRate * dCyclesPerSecond);
+    }
+
+    // any thread: zeroes everything at the start of the next process() call
+    void requestClear() { bClear.store(true, std::memory_order_release); }
+
+private:
+    static void bump(std::atomic<uint64_t>& uCounter, uint64_t uBy = 1)
+    {
+        uCounter.store(uCounter.load(std::memory_order_relaxed) + uBy, std::memory_order_relaxed);
+    }
+
+    void record(int iStage, uint64_t uCycles)
+    {
+        int iBucket = uCycles == 0 ? 0 : 63 - __builtin_clzll(uCycles);
+        bump(ppuHistogram[iStage][iBucket < kBuckets ? iBucket : kBuckets - 1]);
+        bump(puTotal[iStage], uCycles);
+        if (uCycles > puWorst[iStage].load(std::memory_order_relaxed))
+            puWorst[iStage].store(uCycles, std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+        for (int s = 0; s <= NUM_STAGES; s++) {
+            puTotal[s].store(0, std::memory_order_relaxed);
+            puWorst[s].store(0, std::memory_order_relaxed);
+            for (int b = 0; b < kBuckets; b++)
+                ppuHistogram[s][b].store(0, std::memory_order_relaxed);
+        }
+        uBlocks.store(0, std::memory_order_relaxed);
+        uMisses.store(0, std::memory_order_relaxed);
+        uWorstBlock.store(0, std::memory_order_relaxed);
+        iWorstBlockSamples.store(0, std::memory_order_relaxed);
+        fWorstBlockRate.store(0, std::memory_order_relaxed);
+        bClear.store(false, std::memory_order_relaxed);
+    }
+
+    double dCyclesPerSecond; // set once, by the constructor
+
+    // audio thread only
+    uint64_t puBlockCycles[NUM_STAGES];
+    uint64_t uBlockStart;
+
+    // written by the audio thread, readable anywhere ([NUM_STAGES] is the whole call)
+    std::atomic<uint64_t> ppuHistogram[NUM_STAGES + 1][kBuckets];
+    std::atomic<uint64_t> puTotal[NUM_STAGES + 1], puWorst[NUM_STAGES + 1];
+    std::atomic<uint64_t> uBlocks, uMisses, uWorstBlock;
+    std::atomic<int> iWorstBlockSamples;
+    std::atomic<float> fWorstBlockRate;
+    std::atomic<bool> bClear;
+};
+
+#if defined(MYEFFECT_PROFILE)
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_STAGE(profiler, stage) StageProfiler::Scope PROFILE_JOIN(profileScope, __LINE__)(profiler, StageProfiler::stage)
+#define PROFILE_BEGIN(profiler) (profiler).beginBlock()
+#define PROFILE_END(profiler, iCount, fRate) (profiler).endBlock(iCount, fRate)
+#else
+#define PROFILE_STAGE(profiler, stage)
+#define PROFILE_BEGIN(profiler)
+#define PROFILE_END(profiler, iCount, fRate)
+#endif
@@ -0,0 +1,68 @@
+//
+//  TruePeak.h
+//  MyEffect True Peak Meter
+//
+//  The peak of a signal between its samples, as a D/A converter will reconstruct it, following
+//  ITU-R BS.1770-4 Annex 2: the signal is oversampled 4x with the 48-tap polyphase FIR given
+//  there (four 12-tap phases, one for each position between two samples) and the largest
+//  magnitude of the result is taken. A full-scale sine near a quarter of the sample rate can
+//  read 3 dB over its sample peak. The filter looks 6 samples either side, so a peak is seen
+//  about 6 samples after it goes in.
+//
+
+#pragma once
+
+#include <cstring>
+
+#include "SimdKernels.h"
+
+class TruePeak
+{
+public:
+    static const int kPhases = 4;  // oversampling factor (simd::polyphasePeaks() runs four phases)
+    static const int kTaps = 12;   // per phase
+    static const int kChunk = 256; // samples filtered per kernel call
+
+    TruePeak() { reset(); }
+
+    // forgets the history (silence before the next sample)
+    void reset()
+    {
+        for (int i = 0; i < kTaps - 1; i++)
+            pfLine[i] = 0;
+    }
+
+    // pfPeak[i] = the largest magnitude of the oversampled signal at pfIn[i] (any of the four
+    // phases), carrying on from the last call; take the largest of a stretch of it for its true peak
+    void process(const float *pfIn, float *pfPeak, int iCount)
+    {
+        for (int iDone = 0; iDone < iCount; ) {
+            int iSegment = iCount - iDone < kChunk ? iCount - iDone : kChunk;
+
+            //the new samples go in after the last kTaps - 1, which then move to the front for next time
+            memcpy(pfLine + kTaps - 1, pfIn + iDone, iSegment * sizeof(float));
+            simd::polyphasePeaks(pfLine, taps(), kTaps, pfPeak + iDone, iSegment);
+            memmove(pfLine, pfLine + iSegment, (kTaps - 1) * sizeof(float));
+            iDone += iSegment;
+        }
+    }
+
+    // the filter, BS.1770-4 Table 1: kTaps coefficients for each phase in turn
+    static const float* taps()
+    {
+        alignas(32) static const float pfTaps[kPhases * kTaps] = {
+             0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+             0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f,
+            -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+             0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f,
+            -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+             0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f,
+            -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+             0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f,
+        };
+        return pfTaps;
+    }
+
+private:
+    alignas(32) float pfLine[kTaps - 1 + kChunk];
+};
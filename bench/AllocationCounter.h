@@ -0,0 +1,68 @@
+//
+//  AllocationCounter.h
+//  Allocation counting for the bench harness
+//
+//  Replaces the global operator new and delete of the program that includes it (include it in
+//  one source file only) with versions that count every allocation made on a thread while an
+//  AllocationCounter::Scope is open on it. render opens one around each process() call and
+//  fails the run if anything was allocated, since the audio thread must never allocate.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+class AllocationCounter
+{
+public:
+    // counts the allocations made on this thread while it exists
+    class Scope
+    {
+    public:
+        Scope() { bArmed = true; }
+        ~Scope() { bArmed = false; }
+    };
+
+    static long getCount() { return iAllocations.load(std::memory_order_relaxed); }
+    static void clear() { iAllocations.store(0, std::memory_order_relaxed); }
+
+    // called by the replaced operator new
+    static void* allocate(std::size_t uSize)
+    {
+        if (bArmed)
+            iAllocations.fetch_add(1, std::memory_order_relaxed);
+        void *p = malloc(uSize ? uSize : 1);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+    static void* allocate(std::size_t uSize, std::align_val_t alignment)
+    {
+        if (bArmed)
+            iAllocations.fetch_add(1, std::memory_order_relaxed);
+        std::size_t uAlign = static_cast<std::size_t>(alignment);
+        void *p = aligned_alloc(uAlign, (uSize + uAlign - 1) / uAlign * uAlign); //size must be a multiple of the alignment
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+private:
+    static inline thread_local bool bArmed = false;
+    static inline std::atomic<long> iAllocations{0};
+};
+
+void* operator new(std::size_t uSize) { return AllocationCounter::allocate(uSize); }
+void* operator new[](std::size_t uSize) { return AllocationCounter::allocate(uSize); }
+void* operator new(std::size_t uSize, std::align_val_t alignment) { return AllocationCounter::allocate(uSize, alignment); }
+void* operator new[](std::size_t uSize, std::align_val_t alignment) { return AllocationCounter::allocate(uSize, alignment); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+void operator delete[](void *p, std::size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { free(p); }
@@ -0,0 +1,11 @@
+//
+//  EffectExtra.h
+//  Minimal stand-in for the per-plugin extras header
+//
+//  The APDI project template uses this to pull in extra libraries; the bench harness only
+//  needs the maths headers. Only used by bench/.
+//
+
+#pragma once
+
+#include <cmath>
@@ -0,0 +1,227 @@
+//
+//  MappedWav.h
+//  Bench Harness Memory-Mapped WAV Streaming
+//
+//  Reads and writes WAV / RF64 files of any length through memory maps, a block at a time,
+//  for running MyEffect over hours of audio. Blocks are decoded straight from the mapped
+//  input into the plugin's channel buffers, and its output is interleaved straight into the
+//  mapped output file, so nothing is read into memory as a whole or copied on the way.
+//  release() hands the pages already done back to the kernel, so the memory in use stays flat.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "WavFile.h"
+
+// the part of [pStart, pEnd) that covers whole pages inside the mapping at pMap
+inline void pageRange(const uint8_t *pMap, const uint8_t *pStart, const uint8_t *pEnd, uint8_t *&pFirst, size_t& iBytes)
+{
+    size_t iPage = (size_t)sysconf(_SC_PAGESIZE);
+    size_t iFrom = (size_t)(pStart - pMap) / iPage * iPage, iTo = (size_t)(pEnd - pMap) / iPage * iPage;
+    pFirst = const_cast<uint8_t*>(pMap) + iFrom;
+    iBytes = iTo > iFrom ? iTo - iFrom : 0;
+}
+
+class MappedWavReader
+{
+public:
+    MappedWavReader() : pMap(nullptr), uMapSize(0), uReleased(0) {}
+    ~MappedWavReader() { close(); }
+    MappedWavReader(const MappedWavReader&) = delete;
+    MappedWavReader& operator=(const MappedWavReader&) = delete;
+
+    // returns false (and fills sError) if the file cannot be mapped or is not a format we understand
+    bool open(const std::string& sPath, std::string& sError)
+    {
+        close();
+        int iFile = ::open(sPath.c_str(), O_RDONLY);
+        struct stat info;
+        if(iFile < 0 || fstat(iFile, &info) != 0 || info.st_size == 0) {
+            sError = "cannot open " + sPath;
+            if(iFile >= 0)
+                ::close(iFile);
+            return false;
+        }
+        uMapSize = (uint64_t)info.st_size;
+        void *pAddress = mmap(nullptr, uMapSize, PROT_READ, MAP_PRIVATE, iFile, 0);
+        ::close(iFile); // the mapping keeps the file open
+        if(pAddress == MAP_FAILED) {
+            sError = "cannot map " + sPath;
+            uMapSize = 0;
+            return false;
+        }
+        pMap = (uint8_t*)pAddress;
+        madvise(pMap, uMapSize, MADV_SEQUENTIAL); // read ahead aggressively, drop pages behind
+
+        if(!parseWav(pMap, uMapSize, layout, sError)) {
+            sError = sPath + ": " + sError;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if(pMap)
+            munmap(pMap, uMapSize);
+        pMap = nullptr;
+        uMapSize = uReleased = 0;
+    }
+
+    const WavLayout& getLayout() const { return layout; }
+
+    // decodes iCount frames from uFirst into ppOut[0 .. channels - 1]
+    void read(uint64_t uFirst, int iCount, float *const *ppOut) const
+    {
+        const uint8_t *pFrame = layout.pSamples + uFirst * layout.frameBytes();
+        int iChannels = layout.iChannels, iStep = layout.frameBytes();
+
+        if(layout.bFloat) {
+            for(int c = 0; c < iChannels; c++)
+                for(int i = 0; i < iCount; i++)
+                    memcpy(&ppOut[c][i], pFrame + i * iStep + 4 * c, 4);
+        }
+        else if(layout.iBits == 16) {
+            for(int c = 0; c < iChannels; c++)
+                for(int i = 0; i < iCount; i++) {
+                    int16_t iValue;
+                    memcpy(&iValue, pFrame + i * iStep + 2 * c, 2);
+                    ppOut[c][i] = iValue * (1.0f / 32768);
+                }
+        }
+        else {
+            for(int c = 0; c < iChannels; c++)
+                for(int i = 0; i < iCount; i++)
+                    ppOut[c][i] = decodeSample(pFrame + i * iStep + c * layout.sampleBytes(), layout);
+        }
+    }
+
+    // the frames before uFrame are done with: lets the kernel drop their pages
+    void release(uint64_t uFrame)
+    {
+        uint8_t *pFirst;
+        size_t iBytes;
+        pageRange(pMap, layout.pSamples + uReleased * layout.frameBytes(), layout.pSamples + uFrame * layout.frameBytes(), pFirst, iBytes);
+        if(iBytes > 0)
+            madvise(pFirst, iBytes, MADV_DONTNEED);
+        uReleased = uFrame;
+    }
+
+private:
+    uint8_t *pMap;
+    uint64_t uMapSize, uReleased;
+    WavLayout layout;
+};
+
+// writes a 32-bit float WAV file (RF64 once the data passes 4 GB) of a length known up front
+class MappedWavWriter
+{
+public:
+    MappedWavWriter() : iFile(-1), pMap(nullptr), pSamples(nullptr), uMapSize(0), uReleased(0), iChannels(0) {}
+    ~MappedWavWriter() { std::string sError; close(sError); }
+    MappedWavWriter(const MappedWavWriter&) = delete;
+    MappedWavWriter& operator=(const MappedWavWriter&) = delete;
+
+    bool open(const std::string& sPath, int iNewChannels, float fSampleRate, uint64_t uFrames, std::string& sError)
+    {
+        close(sError);
+        iChannels = iNewChannels;
+        uint64_t uDataBytes = uFrames * iChannels * 4;
+        bool bRF64 = uDataBytes + 36 > 0xFFFFFFFFull;
+        uint64_t uHeader = bRF64 ? 80 : 44;
+        uMapSize = uHeader + uDataBytes;
+
+        iFile = ::open(sPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(iFile < 0 || ftruncate(iFile, (off_t)uMapSize) != 0) {
+            sError = "cannot create " + sPath;
+            close(sError);
+            return false;
+        }
+        void *pAddress = mmap(nullptr, uMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+        if(pAddress == MAP_FAILED) {
+            sError = "cannot map " + sPath;
+            pMap = nullptr;
+            close(sError);
+            return false;
+        }
+        pMap = (uint8_t*)pAddress;
+        pSamples = pMap + uHeader;
+
+        uint8_t *p = pMap;
+        auto put = [&p](uint64_t uValue, int iBytes) { for(int b = 0; b < iBytes; b++) *p++ = (uValue >> (8 * b)) & 0xFF; };
+        auto tag = [&p](const char *sTag) { memcpy(p, sTag, 4); p += 4; };
+
+        tag(bRF64 ? "RF64" : "RIFF"); put(bRF64 ? 0xFFFFFFFF : uMapSize - 8, 4);
+        tag("WAVE");
+        if(bRF64) {
+            tag("ds64"); put(28, 4);
+            put(uMapSize - 8, 8);                                  // RIFF size
+            put(uDataBytes, 8);                                    // data size
+            put(uFrames, 8);                                       // sample count
+            put(0, 4);                                             // no table
+        }
+        tag("fmt "); put(16, 4);
+        put(3, 2);                                                 // IEEE float
+        put(iChannels, 2);
+        put((uint32_t)fSampleRate, 4);
+        put((uint32_t)fSampleRate * iChannels * 4, 4);
+        put(iChannels * 4, 2);
+        put(32, 2);
+        tag("data"); put(bRF64 ? 0xFFFFFFFF : uDataBytes, 4);
+        return true;
+    }
+
+    // interleaves iCount frames of ppIn[0 .. channels - 1] into the file from frame uFirst
+    void write(uint64_t uFirst, int iCount, const float *const *ppIn)
+    {
+        uint8_t *pFrame = pSamples + uFirst * iChannels * 4;
+        for(int c = 0; c < iChannels; c++)
+            for(int i = 0; i < iCount; i++)
+                memcpy(pFrame + (i * iChannels + c) * 4, &ppIn[c][i], 4);
+    }
+
+    // the frames before uFrame are finished: starts writing them out and drops their pages
+    void release(uint64_t uFrame)
+    {
+        uint8_t *pFirst;
+        size_t iBytes;
+        pageRange(pMap, pSamples + uReleased * iChannels * 4, pSamples + uFrame * iChannels * 4, pFirst, iBytes);
+        if(iBytes > 0) {
+            msync(pFirst, iBytes, MS_ASYNC);
+            madvise(pFirst, iBytes, MADV_DONTNEED); // dirty pages stay in the page cache until written
+        }
+        uReleased = uFrame;
+    }
+
+    // returns false (and fills sError) if the file could not be completed
+    bool close(std::string& sError)
+    {
+        bool bOK = true;
+        if(pMap)
+            bOK = munmap(pMap, uMapSize) == 0;
+        if(iFile >= 0)
+            bOK = ::close(iFile) == 0 && bOK;
+        if(!bOK)
+            sError = "cannot finish writing the output";
+        iFile = -1;
+        pMap = pSamples = nullptr;
+        uMapSize = uReleased = 0;
+        return bOK;
+    }
+
+private:
+    int iFile;
+    uint8_t *pMap, *pSamples;
+    uint64_t uMapSize, uReleased;
+    int iChannels;
+};
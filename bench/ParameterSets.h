@@ -0,0 +1,43 @@
+//
+//  ParameterSets.h
+//  Bench Harness Parameter Sets
+//
+//  Named control settings the harness sweeps over. Indices follow the CONTROLS array in
+//  EffectPlugin.cpp; anything not listed keeps its initial value.
+//
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ParameterSet
+{
+    std::string name;
+    std::vector<std::pair<int, float>> values; // { control index, value }
+};
+
+inline const std::vector<ParameterSet>& parameterSets()
+{
+    static const std::vector<ParameterSet> sets = {
+        { "initial",  { } },
+        { "gate-bp",  { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {8, 0}, {11, 1000}, {12, 800} } },
+        { "gate-lp",  { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {8, 1}, {9, 500} } },
+        { "gate-hp",  { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {8, 2}, {10, 2000} } },
+        { "gate-la",  { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {8, 0}, {11, 1000}, {12, 800}, {18, 5} } },
+        { "multiband", { {2, -50}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -30}, {20, 1} } },
+        { "delay",    { {13, 0.5f}, {14, 250}, {15, 100}, {16, 100} } },
+        { "full",     { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {8, 0}, {11, 1000}, {12, 800},
+                        {13, 0.5f}, {14, 250}, {15, 100}, {16, 100} } },
+    };
+    return sets;
+}
+
+inline const ParameterSet* findParameterSet(const std::string& sName)
+{
+    for(const ParameterSet& set : parameterSets())
+        if(set.name == sName)
+            return &set;
+    return nullptr;
+}
@@ -0,0 +1,84 @@
+//
+//  Signals.h
+//  Bench Harness Test Signals
+//
+//  Deterministic synthetic stereo signals, so runs on different machines see the same audio.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "WavFile.h"
+
+// small LCG so the noise is identical on every platform (std:: distributions are not)
+class NoiseSource
+{
+public:
+    explicit NoiseSource(uint32_t uSeed = 1) : uState(uSeed) {}
+
+    float next() // uniform in [-1, 1)
+    {
+        uState = uState * 1664525u + 1013904223u;
+        return (float)((int32_t)uState / 2147483648.0);
+    }
+
+private:
+    uint32_t uState;
+};
+
+inline const char* const* signalNames()
+{
+    static const char* const names[] = { "bursts", "speech", "noise", "sine", "silence", nullptr };
+    return names;
+}
+
+// returns false if sName is not one of signalNames()
+inline bool makeSignal(const std::string& sName, float fSampleRate, float fSeconds, AudioData& audio)
+{
+    int iFrames = (int)(fSampleRate * fSeconds);
+    audio.fSampleRate = fSampleRate;
+    audio.channels.assign(2, std::vector<float>(iFrames, 0.f));
+    NoiseSource noise(12345);
+
+    for(int f = 0; f < iFrames; f++) {
+        float fTime = f / fSampleRate, fL = 0, fR = 0;
+
+        if(sName == "bursts") {
+            // 200 ms noise bursts at -12 dBFS every 500 ms, over a -60 dBFS noise floor
+            bool bOn = fmodf(fTime, 0.5f) < 0.2f;
+            float fLevel = bOn ? 0.25f : 0.001f;
+            fL = noise.next() * fLevel;
+            fR = noise.next() * fLevel;
+        }
+        else if(sName == "speech") {
+            // syllables of voiced sound (a gliding 120-180 Hz pitch with its first harmonics, plus
+            // some breath noise) at about 4 per second, phrases of 1.5 s with a 0.5 s pause after
+            // each, over a -60 dBFS noise floor
+            float fPhrase = fmodf(fTime, 2.0f), fSyllable = fmodf(fTime * 4.3f, 1.0f);
+            float fEnvelope = fPhrase < 1.5f ? 0.2f * (float)pow(sin(M_PI * fSyllable), 2.0) : 0;
+            double dPhase = 2.0 * M_PI * (150.0 * fTime - 30.0 / (2.0 * M_PI * 0.7) * cos(2.0 * M_PI * 0.7 * fTime));
+            float fVoice = 0;
+            for(int h = 1; h <= 6; h++)
+                fVoice += (float)sin(h * dPhase) / h;
+            float fBreath = noise.next() * 0.15f;
+            fL = fEnvelope * (0.6f * fVoice + fBreath) + noise.next() * 0.001f;
+            fR = 0.8f * fL + noise.next() * 0.001f;
+        }
+        else if(sName == "noise") {
+            fL = noise.next() * 0.25f;
+            fR = noise.next() * 0.25f;
+        }
+        else if(sName == "sine") {
+            fL = fR = 0.25f * (float)sin(2.0 * M_PI * 440.0 * fTime);
+        }
+        else if(sName != "silence")
+            return false;
+
+        audio.channels[0][f] = fL;
+        audio.channels[1][f] = fR;
+    }
+    return true;
+}
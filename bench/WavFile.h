@@ -0,0 +1,170 @@
+//
+//  WavFile.h
+//  Bench Harness WAV Reader / Writer
+//
+//  Loads PCM (16/24/32-bit) and 32-bit float WAV and RF64 files into deinterleaved float
+//  channels, and writes 32-bit float WAV files, for feeding real recordings through
+//  MyEffect::process(). parseWav() and decodeSample() also serve the memory-mapped reader.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct AudioData
+{
+    float fSampleRate = 44100;
+    std::vector<std::vector<float>> channels; // deinterleaved, all the same length
+
+    int numChannels() const { return (int)channels.size(); }
+    int numFrames() const { return channels.empty() ? 0 : (int)channels[0].size(); }
+};
+
+inline uint32_t readLE(const uint8_t *pData, int iBytes)
+{
+    uint32_t uValue = 0;
+    for(int b = 0; b < iBytes; b++)
+        uValue |= (uint32_t)pData[b] << (8 * b);
+    return uValue;
+}
+
+// where the samples are in a WAV file image, and how they are stored
+struct WavLayout
+{
+    float fSampleRate = 44100;
+    int iChannels = 0, iBits = 0;
+    bool bFloat = false;
+    const uint8_t *pSamples = nullptr; // interleaved frames
+    uint64_t uFrames = 0;
+
+    int sampleBytes() const { return iBits / 8; }
+    int frameBytes() const { return iChannels * iBits / 8; }
+};
+
+// Finds the format and sample data in a whole RIFF/WAVE or RF64 file image (RF64, and BW64,
+// keep 64-bit sizes in a ds64 chunk, for files past 4 GB). Returns false, and fills sError,
+// if it is not a format we understand.
+inline bool parseWav(const uint8_t *pData, uint64_t uSize, WavLayout& layout, std::string& sError)
+{
+    bool bRF64 = uSize >= 12 && (!memcmp(pData, "RF64", 4) || !memcmp(pData, "BW64", 4));
+    if(uSize < 12 || (memcmp(pData, "RIFF", 4) && !bRF64) || memcmp(pData + 8, "WAVE", 4)) {
+        sError = "not a RIFF/WAVE or RF64 file";
+        return false;
+    }
+
+    int iFormat = 0;
+    uint64_t uDataBytes = 0, uRF64DataBytes = 0;
+    layout = WavLayout();
+
+    for(uint64_t pos = 12; pos + 8 <= uSize; ) {
+        uint64_t uChunk = readLE(pData + pos + 4, 4);
+        const uint8_t *pBody = pData + pos + 8;
+        uint64_t uAvailable = uSize - pos - 8;
+
+        if(!memcmp(pData + pos, "ds64", 4) && uChunk >= 16 && uAvailable >= 16)
+            uRF64DataBytes = readLE(pBody + 8, 4) | (uint64_t)readLE(pBody + 12, 4) << 32;
+        else if(!memcmp(pData + pos, "fmt ", 4) && uChunk >= 16) {
+            iFormat = readLE(pBody, 2);
+            layout.iChannels = readLE(pBody + 2, 2);
+            layout.fSampleRate = (float)readLE(pBody + 4, 4);
+            layout.iBits = readLE(pBody + 14, 2);
+            if(iFormat == 0xFFFE && uChunk >= 26) // WAVE_FORMAT_EXTENSIBLE: real format is in the sub-format GUID
+                iFormat = readLE(pBody + 24, 2);
+        }
+        else if(!memcmp(pData + pos, "data", 4)) {
+            if(bRF64 && uChunk == 0xFFFFFFFF) // the real size is in ds64
+                uChunk = uRF64DataBytes;
+            layout.pSamples = pBody;
+            uDataBytes = uChunk < uAvailable ? uChunk : uAvailable;
+        }
+        pos += 8 + uChunk + (uChunk & 1);
+    }
+
+    bool bPCM = iFormat == 1 && (layout.iBits == 16 || layout.iBits == 24 || layout.iBits == 32);
+    layout.bFloat = iFormat == 3 && layout.iBits == 32;
+    if(!layout.pSamples || layout.iChannels < 1 || (!bPCM && !layout.bFloat)) {
+        sError = "only 16/24/32-bit PCM and 32-bit float WAV files are supported";
+        return false;
+    }
+    layout.uFrames = uDataBytes / layout.frameBytes();
+    return true;
+}
+
+// one stored sample as a float in [-1, 1)
+inline float decodeSample(const uint8_t *pSample, const WavLayout& layout)
+{
+    uint32_t uRaw = readLE(pSample, layout.sampleBytes());
+    float fValue;
+    if(layout.bFloat)
+        memcpy(&fValue, &uRaw, 4);
+    else {
+        int32_t iValue = (int32_t)(uRaw << (32 - layout.iBits)); // sign-extend into the top bits
+        fValue = (float)(iValue / 2147483648.0);
+    }
+    return fValue;
+}
+
+// returns false (and fills sError) if the file is missing or not a format we understand
+inline bool readWav(const std::string& sPath, AudioData& audio, std::string& sError)
+{
+    FILE *pFile = fopen(sPath.c_str(), "rb");
+    if(!pFile) { sError = "cannot open " + sPath; return false; }
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t iRead;
+    while((iRead = fread(chunk, 1, sizeof(chunk), pFile)) > 0)
+        data.insert(data.end(), chunk, chunk + iRead);
+    fclose(pFile);
+
+    WavLayout layout;
+    if(!parseWav(data.data(), data.size(), layout, sError)) {
+        sError = sPath + ": " + sError;
+        return false;
+    }
+
+    audio.fSampleRate = layout.fSampleRate;
+    audio.channels.assign(layout.iChannels, std::vector<float>(layout.uFrames));
+
+    for(size_t f = 0; f < layout.uFrames; f++)
+        for(int c = 0; c < layout.iChannels; c++)
+            audio.channels[c][f] = decodeSample(layout.pSamples + f * layout.frameBytes() + c * layout.sampleBytes(), layout);
+    return true;
+}
+
+inline void writeLE(FILE *pFile, uint32_t uValue, int iBytes)
+{
+    for(int b = 0; b < iBytes; b++)
+        fputc((uValue >> (8 * b)) & 0xFF, pFile);
+}
+
+inline bool writeWav(const std::string& sPath, const AudioData& audio)
+{
+    FILE *pFile = fopen(sPath.c_str(), "wb");
+    if(!pFile)
+        return false;
+
+    uint32_t uChannels = audio.numChannels(), uFrames = audio.numFrames();
+    uint32_t uDataBytes = uFrames * uChannels * 4;
+
+    fwrite("RIFF", 1, 4, pFile); writeLE(pFile, 36 + uDataBytes, 4);
+    fwrite("WAVE", 1, 4, pFile);
+    fwrite("fmt ", 1, 4, pFile); writeLE(pFile, 16, 4);
+    writeLE(pFile, 3, 2);                                   // IEEE float
+    writeLE(pFile, uChannels, 2);
+    writeLE(pFile, (uint32_t)audio.fSampleRate, 4);
+    writeLE(pFile, (uint32_t)audio.fSampleRate * uChannels * 4, 4);
+    writeLE(pFile, uChannels * 4, 2);
+    writeLE(pFile, 32, 2);
+    fwrite("data", 1, 4, pFile); writeLE(pFile, uDataBytes, 4);
+
+    for(uint32_t f = 0; f < uFrames; f++)
+        for(uint32_t c = 0; c < uChannels; c++)
+            fwrite(&audio.channels[c][f], 4, 1, pFile);
+
+    return fclose(pFile) == 0;
+}
@@ -0,0 +1,92 @@
+//
+//  Helpers.h
+//  Minimal stand-in for the APDI helper classes
+//
+//  Provides the global STK sample rate and the LPF / HPF / BPF sidechain filters used by
+//  EffectPlugin.cpp, as plain RBJ biquads. Only used by bench/.
+//
+
+#pragma once
+
+#include <cmath>
+
+namespace stk {
+
+class Stk
+{
+public:
+    static void setSampleRate(double dRate) { rate() = dRate; }
+    static double sampleRate() { return rate(); }
+
+private:
+    static double& rate() { static double dRate = 44100.0; return dRate; }
+};
+
+} // namespace stk
+
+namespace APDI {
+
+// direct form I biquad, coefficients normalised by a0
+class Biquad
+{
+public:
+    Biquad() : b0(1), b1(0), b2(0), a1(0), a2(0), x1(0), x2(0), y1(0), y2(0) {}
+
+    float tick(float fIn)
+    {
+        float fOut = b0 * fIn + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1; x1 = fIn;
+        y2 = y1; y1 = fOut;
+        return fOut;
+    }
+
+protected:
+    void setCoefficients(double dB0, double dB1, double dB2, double dA0, double dA1, double dA2)
+    {
+        b0 = (float)(dB0 / dA0); b1 = (float)(dB1 / dA0); b2 = (float)(dB2 / dA0);
+        a1 = (float)(dA1 / dA0); a2 = (float)(dA2 / dA0);
+    }
+
+    static double omega(float fFrequency)
+    {
+        double dNyquist = 0.49 * stk::Stk::sampleRate();
+        double dFrequency = fFrequency < 1 ? 1 : (fFrequency > dNyquist ? dNyquist : fFrequency);
+        return 2.0 * M_PI * dFrequency / stk::Stk::sampleRate();
+    }
+
+    float b0, b1, b2, a1, a2;
+    float x1, x2, y1, y2;
+};
+
+class LPF : public Biquad
+{
+public:
+    void setCutoff(float fCutoff)
+    {
+        double w = omega(fCutoff), alpha = sin(w) / (2.0 * M_SQRT1_2), c = cos(w);
+        setCoefficients((1 - c) / 2, 1 - c, (1 - c) / 2, 1 + alpha, -2 * c, 1 - alpha);
+    }
+};
+
+class HPF : public Biquad
+{
+public:
+    void setCutoff(float fCutoff)
+    {
+        double w = omega(fCutoff), alpha = sin(w) / (2.0 * M_SQRT1_2), c = cos(w);
+        setCoefficients((1 + c) / 2, -(1 + c), (1 + c) / 2, 1 + alpha, -2 * c, 1 - alpha);
+    }
+};
+
+class BPF : public Biquad
+{
+public:
+    void set(float fCentre, float fBandwidth)
+    {
+        double w = omega(fCentre), q = fCentre / (fBandwidth < 1 ? 1 : fBandwidth);
+        double alpha = sin(w) / (2.0 * q), c = cos(w);
+        setCoefficients(alpha, 0, -alpha, 1 + alpha, -2 * c, 1 - alpha);
+    }
+};
+
+} // namespace APDI
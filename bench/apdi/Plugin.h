@@ -0,0 +1,112 @@
+//
+//  Plugin.h
+//  Minimal stand-in for the APDI plugin interface
+//
+//  Declares just enough of APDI::Effect, Parameters and Presets for EffectPlugin.cpp to be
+//  compiled and driven outside the APDI host by the bench harness. Only used by bench/.
+//
+
+#pragma once
+
+#include <cmath>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace APDI {
+
+struct Rect
+{
+    int x, y, w, h;
+};
+
+#define AUTO_SIZE { -1, -1, -1, -1 }
+
+struct Parameter
+{
+    enum Type { ROTARY, BUTTON, TOGGLE, SLIDER, MENU, METER };
+
+    Parameter(const char *sName, Type type, float fMin, float fMax, float fInitial, Rect size)
+    : name(sName), type(type), min(fMin), max(fMax), initial(fInitial), size(size) {}
+
+    Parameter(const char *sName, Type type, std::initializer_list<const char*> items, Rect size)
+    : name(sName), type(type), min(0), max((float)items.size() - 1), initial(0), options(items.begin(), items.end()), size(size) {}
+
+    std::string name;
+    Type type;
+    float min, max, initial;
+    std::vector<std::string> options;
+    Rect size;
+};
+
+typedef std::vector<Parameter> Parameters;
+
+struct Preset
+{
+    std::string name;
+    std::vector<float> values;
+};
+
+typedef std::vector<Preset> Presets;
+
+// live control values, indexed the same way as the CONTROLS array
+class ParameterValues
+{
+public:
+    float& operator[](int iIndex) { return values[iIndex]; }
+    const float& operator[](int iIndex) const { return values[iIndex]; }
+    int size() const { return (int)values.size(); }
+
+    std::vector<float> values;
+};
+
+class Effect
+{
+public:
+    Effect(const Parameters& controls, const Presets& presets)
+    : controls(controls), presets(presets)
+    {
+        for(const Parameter& control : controls)
+            parameters.values.push_back(control.initial);
+    }
+    virtual ~Effect() {}
+
+    virtual void setSampleRate(float sampleRate) = 0;
+    virtual float getSampleRate() const = 0;
+
+    virtual void process(const float** inputBuffers, float** outputBuffers, int numSamples) = 0;
+
+    virtual void presetLoaded(int iPresetNum, const char *sPresetName) {}
+    virtual void optionChanged(int iOptionMenu, int iItem) {}
+    virtual void buttonPressed(int iButton) {}
+
+    // host side of the interface (used by the bench harness in place of the APDI UI)
+    int getNumParameters() const { return parameters.size(); }
+    const Parameter& getControl(int iIndex) const { return controls[iIndex]; }
+    float getParameter(int iIndex) const { return parameters[iIndex]; }
+
+    void setParameter(int iIndex, float fValue)
+    {
+        parameters[iIndex] = fValue;
+        if(controls[iIndex].type == Parameter::MENU)
+            optionChanged(iIndex, (int)fValue);
+    }
+
+    void loadPreset(int iPresetNum)
+    {
+        const Preset& preset = presets[iPresetNum];
+        for(int p = 0; p < (int)preset.values.size() && p < parameters.size(); p++)
+            if(controls[p].type != Parameter::METER)
+                setParameter(p, preset.values[p]);
+        presetLoaded(iPresetNum, preset.name.c_str());
+    }
+
+protected:
+    Parameters controls;
+    Presets presets;
+    ParameterValues parameters;
+};
+
+} // namespace APDI
+
+#define CREATE_FUNCTION __attribute__((visibility("default"))) APDI::Effect*
@@ -0,0 +1,217 @@
+//
+//  batch.cpp
+//  Batched Gate Engine Benchmark
+//
+//  Runs N stereo gates, each with its own settings, two ways: as N MyEffect instances with a
+//  process() call each, and as GateBatch engines of 4, 8 or 16 instances. Reports the cost per
+//  instance for each and checks that every instance's output is identical both ways. Then runs
+//  the batches of 8 again with their echo lines sized for the longest delay in use and stored
+//  as halves, and reports the memory they take and how far the output moves.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apdi/Plugin.h"
+#include "apdi/Helpers.h"
+#include "GateBatch.h"
+#include "Signals.h"
+
+extern "C" CREATE_FUNCTION createEffect(float sampleRate);
+
+typedef std::chrono::steady_clock Clock;
+typedef std::vector<std::vector<float>> Bus;
+
+// control values for instance k: the "full" set, spread out so no two instances match
+static std::vector<std::pair<int, float>> instanceControls(int k)
+{
+    return {
+        {2, -48.0f + (k % 7) * 3}, {3, -6}, {4, 2.0f + (k % 5)}, {5, 20.0f + (k % 4) * 20}, {6, 30.0f + (k % 3) * 20},
+        {7, -60}, {8, (float)(k % 3)}, {9, 400}, {10, 2000}, {11, 600.0f + (k % 8) * 100}, {12, 800},
+        {13, 0.4f}, {14, 150.0f + (k % 6) * 25}, {15, 80}, {16, 100}, {17, 1.0f + (k % 2)}, {18, 0},
+    };
+}
+
+// the same values as GateEngine settings, as MyEffect::process() hands them over
+static GateEngineBase::Settings instanceSettings(int k)
+{
+    float p[20] = {};
+    for(const auto& value : instanceControls(k))
+        p[value.first] = value.second;
+
+    GateEngineBase::Settings settings;
+    settings.fThreshDb = p[2]; settings.fHystDb = p[3]; settings.fAttack = p[4]; settings.fHold = p[5];
+    settings.fRelease = p[6]; settings.fReductionDb = p[7]; settings.filterType = (SidechainFilter::Type)(int)p[8];
+    settings.fLowPass = p[9]; settings.fHighPass = p[10]; settings.fCentre = p[11]; settings.fWidth = p[12];
+    settings.fFeedback = p[13]; settings.fDelayTime = p[14]; settings.fWetPercent = p[15]; settings.fDryPercent = p[16];
+    settings.fDetector = p[17]; settings.fLookahead = p[18];
+    settings.link = GateEngineBase::LINKED;
+    settings.bands = GateEngineBase::BROADBAND;
+    return settings;
+}
+
+// two channels per instance, bursts offset in time so the gates open at different moments
+static Bus makeInputs(int iInstances, float fSampleRate, float fSeconds)
+{
+    int iFrames = (int)(fSampleRate * fSeconds);
+    Bus bus(2 * iInstances, std::vector<float>(iFrames));
+    NoiseSource noise(12345);
+    for(int f = 0; f < iFrames; f++)
+        for(int c = 0; c < 2 * iInstances; c++) {
+            bool bOn = fmodf(f / fSampleRate + 0.013f * (c / 2), 0.5f) < 0.2f;
+            bus[c][f] = noise.next() * (bOn ? 0.25f : 0.001f);
+        }
+    return bus;
+}
+
+// one MyEffect per instance, a process() call each per block; returns seconds spent processing
+static double runInstances(const Bus& in, Bus& out, float fSampleRate, int iBlockSize)
+{
+    int iInstances = (int)in.size() / 2, iFrames = (int)in[0].size();
+    std::vector<std::unique_ptr<APDI::Effect>> effects;
+
+    stk::Stk::setSampleRate(fSampleRate);
+    for(int k = 0; k < iInstances; k++) {
+        effects.emplace_back(createEffect(fSampleRate));
+        for(int p = 0; p < effects[k]->getNumParameters(); p++)
+            if(effects[k]->getControl(p).type == APDI::Parameter::MENU)
+                effects[k]->setParameter(p, effects[k]->getParameter(p));
+        for(const auto& value : instanceControls(k))
+            effects[k]->setParameter(value.first, value.second);
+    }
+
+    Clock::duration total(0);
+    for(int iPos = 0; iPos < iFrames; iPos += iBlockSize) {
+        int iCount = std::min(iBlockSize, iFrames - iPos);
+        Clock::time_point start = Clock::now();
+        for(int k = 0; k < iInstances; k++) {
+            const float *ppIn[2] = { in[2 * k].data() + iPos, in[2 * k + 1].data() + iPos };
+            float *ppOut[2] = { out[2 * k].data() + iPos, out[2 * k + 1].data() + iPos };
+            effects[k]->process(ppIn, ppOut, iCount);
+        }
+        total += Clock::now() - start;
+    }
+    return std::chrono::duration<double>(total).count();
+}
+
+// the same instances, Lanes at a time, with the echo lines sized as given (their total size goes in *pDelayBytes)
+template <int Lanes>
+double runBatches(const Bus& in, Bus& out, float fSampleRate, int iBlockSize, float fMaxDelayMs = GateEngineBase::kMaxDelayTime,
+                  MultiTapDelay::Storage storage = MultiTapDelay::FLOAT32, size_t *pDelayBytes = nullptr)
+{
+    int iInstances = (int)in.size() / 2, iFrames = (int)in[0].size();
+    int iBatches = (iInstances + Lanes - 1) / Lanes;
+    std::vector<std::unique_ptr<GateBatch<Lanes>>> batches;
+    std::vector<float> silence(iBlockSize), discard(iBlockSize);
+
+    for(int b = 0; b < iBatches; b++) {
+        batches.emplace_back(new GateBatch<Lanes>);
+        batches[b]->setDelayOptions(fMaxDelayMs, storage);
+        batches[b]->prepare(fSampleRate);
+        for(int l = 0; l < Lanes; l++)
+            batches[b]->setSettings(l, instanceSettings(b * Lanes + l));
+    }
+
+    if(pDelayBytes) {
+        *pDelayBytes = 0;
+        for(int b = 0; b < iBatches; b++)
+            *pDelayBytes += batches[b]->getDelayBytes();
+    }
+
+    Clock::duration total(0);
+    for(int iPos = 0; iPos < iFrames; iPos += iBlockSize) {
+        int iCount = std::min(iBlockSize, iFrames - iPos);
+        Clock::time_point start = Clock::now();
+        for(int b = 0; b < iBatches; b++) {
+            const float *ppIn[2 * Lanes];
+            float *ppOut[2 * Lanes];
+            for(int c = 0; c < 2 * Lanes; c++) {
+                int iChannel = 2 * b * Lanes + c;
+                bool bUsed = iChannel < 2 * iInstances; // a part-filled last batch runs its spare lanes on silence
+                ppIn[c] = bUsed ? in[iChannel].data() + iPos : silence.data();
+                ppOut[c] = bUsed ? out[iChannel].data() + iPos : discard.data();
+            }
+            batches[b]->process(ppIn, ppOut, iCount, fSampleRate);
+        }
+        total += Clock::now() - start;
+    }
+    return std::chrono::duration<double>(total).count();
+}
+
+static float maxDifference(const Bus& a, const Bus& b)
+{
+    float fWorst = 0;
+    for(size_t c = 0; c < a.size(); c++)
+        for(size_t f = 0; f < a[c].size(); f++)
+            fWorst = std::max(fWorst, fabsf(a[c][f] - b[c][f]));
+    return fWorst;
+}
+
+int main(int argc, char *argv[])
+{
+    float fSampleRate = 48000, fSeconds = 2;
+    int iInstances = 64, iBlockSize = 64;
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--instances" && bHasValue) iInstances = atoi(argv[++a]);
+        else if(sArg == "--rate" && bHasValue) fSampleRate = (float)atof(argv[++a]);
+        else if(sArg == "--block" && bHasValue) iBlockSize = atoi(argv[++a]);
+        else if(sArg == "--seconds" && bHasValue) fSeconds = (float)atof(argv[++a]);
+        else {
+            printf("usage: batch [--instances N] [--rate HZ] [--block N] [--seconds S]\n");
+            return sArg == "--help" ? 0 : 1;
+        }
+    }
+
+    Bus in = makeInputs(iInstances, fSampleRate, fSeconds);
+    Bus reference(in), batched(in);
+    double dAudio = fSeconds * iInstances;
+
+    printf("%d instances, %d Hz, %d-sample blocks\n", iInstances, (int)fSampleRate, iBlockSize);
+    printf("engine         us/instance-second  speedup   output\n");
+
+    double dSeparate = runInstances(in, reference, fSampleRate, iBlockSize);
+    printf("MyEffect x %-3d %18.2f %8s   reference\n", iInstances, 1e6 * dSeparate / dAudio, "1.00x");
+
+    bool bOk = true;
+    double pdBatch[3];
+    pdBatch[0] = runBatches<4>(in, batched, fSampleRate, iBlockSize);
+    float fDiff4 = maxDifference(reference, batched);
+    pdBatch[1] = runBatches<8>(in, batched, fSampleRate, iBlockSize);
+    float fDiff8 = maxDifference(reference, batched);
+    pdBatch[2] = runBatches<16>(in, batched, fSampleRate, iBlockSize);
+    float fDiff16 = maxDifference(reference, batched);
+
+    const int piLanes[3] = { 4, 8, 16 };
+    const float pfDiff[3] = { fDiff4, fDiff8, fDiff16 };
+    for(int i = 0; i < 3; i++) {
+        printf("GateBatch<%-2d> %19.2f %7.2fx   ", piLanes[i], 1e6 * pdBatch[i] / dAudio, dSeparate / pdBatch[i]);
+        if(pfDiff[i] == 0) printf("identical\n");
+        else printf("DIFFERS (max %g)\n", pfDiff[i]);
+        bOk = bOk && pfDiff[i] == 0;
+    }
+
+    //the instances' delay times go up to 275 ms
+    printf("\necho lines (GateBatch<8>)  KB/instance  us/instance-second   output\n");
+    const float pfMaxDelay[3] = { GateEngineBase::kMaxDelayTime, 300, 300 };
+    const MultiTapDelay::Storage pStorage[3] = { MultiTapDelay::FLOAT32, MultiTapDelay::FLOAT32, MultiTapDelay::FLOAT16 };
+    for(int i = 0; i < 3; i++) {
+        size_t uBytes = 0;
+        double dTime = runBatches<8>(in, batched, fSampleRate, iBlockSize, pfMaxDelay[i], pStorage[i], &uBytes);
+        float fDiff = maxDifference(reference, batched);
+        printf("%-6s, %4d ms %17.1f %20.2f   ", pStorage[i] == MultiTapDelay::FLOAT32 ? "floats" : "halves", (int)pfMaxDelay[i],
+               uBytes / 1024.0 / ((iInstances + 7) / 8 * 8), 1e6 * dTime / dAudio);
+        if(fDiff == 0) printf("identical\n");
+        else printf("max difference %.2g (%.0f dB)\n", fDiff, 20 * log10f(fDiff));
+        bOk = bOk && (pStorage[i] == MultiTapDelay::FLOAT16 || fDiff == 0);
+    }
+    return bOk ? 0 : 1;
+}
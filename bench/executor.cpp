@@ -0,0 +1,211 @@
+//
+//  executor.cpp
+//  Multi-core Executor Benchmark
+//
+//  Runs a set of tracks, each a chain of MyEffect instances, block by block: once serially on
+//  one thread, and then through RealtimeExecutor with growing worker counts. For each run it
+//  reports the mean and worst block time against the deadline, deadline misses and the load
+//  of every worker, and checks the output matches the serial run exactly.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "apdi/Plugin.h"
+#include "apdi/Helpers.h"
+#include "ParameterSets.h"
+#include "RealtimeExecutor.h"
+#include "Signals.h"
+
+extern "C" CREATE_FUNCTION createEffect(float sampleRate);
+
+typedef std::chrono::steady_clock Clock;
+
+// one effect in a track's chain, with the buffers it reads and writes this block
+struct Stage
+{
+    std::unique_ptr<APDI::Effect> effect;
+    const float *ppIn[2];
+    float *ppOut[2];
+    int iCount;
+
+    static void run(void *pContext)
+    {
+        Stage *pStage = (Stage*)pContext;
+        pStage->effect->process(pStage->ppIn, pStage->ppOut, pStage->iCount);
+    }
+};
+
+// a gate feeding a delay, on its own two channels
+struct Track
+{
+    Stage stages[2];
+    std::vector<float> input[2], middle[2], output[2];
+};
+
+static std::unique_ptr<APDI::Effect> createStage(float fSampleRate, const char *sParams)
+{
+    std::unique_ptr<APDI::Effect> effect(createEffect(fSampleRate));
+    for(int p = 0; p < effect->getNumParameters(); p++)
+        if(effect->getControl(p).type == APDI::Parameter::MENU)
+            effect->setParameter(p, effect->getParameter(p));
+    for(const auto& value : findParameterSet(sParams)->values)
+        effect->setParameter(value.first, value.second);
+    return effect;
+}
+
+static std::vector<std::unique_ptr<Track>> createTracks(int iTracks, float fSampleRate, int iBlockSize)
+{
+    std::vector<std::unique_ptr<Track>> tracks;
+    NoiseSource noise(12345);
+    stk::Stk::setSampleRate(fSampleRate);
+
+    for(int t = 0; t < iTracks; t++) {
+        std::unique_ptr<Track> track(new Track);
+        track->stages[0].effect = createStage(fSampleRate, "gate-bp");
+        track->stages[1].effect = createStage(fSampleRate, "delay");
+        for(int c = 0; c < 2; c++) {
+            track->input[c].resize(iBlockSize);
+            track->middle[c].resize(iBlockSize);
+            track->output[c].resize(iBlockSize);
+            track->stages[0].ppIn[c] = track->input[c].data();
+            track->stages[0].ppOut[c] = track->middle[c].data();
+            track->stages[1].ppIn[c] = track->middle[c].data();
+            track->stages[1].ppOut[c] = track->output[c].data();
+        }
+        tracks.push_back(std::move(track));
+    }
+    return tracks;
+}
+
+// next block of input for every track: bursts, offset per track
+static void fillInputs(std::vector<std::unique_ptr<Track>>& tracks, int iPos, int iBlockSize, float fSampleRate, NoiseSource& noise)
+{
+    for(size_t t = 0; t < tracks.size(); t++)
+        for(int i = 0; i < iBlockSize; i++) {
+            bool bOn = fmodf((iPos + i) / fSampleRate + 0.021f * t, 0.5f) < 0.2f;
+            for(int c = 0; c < 2; c++)
+                tracks[t]->input[c][i] = noise.next() * (bOn ? 0.25f : 0.001f);
+        }
+}
+
+struct Result
+{
+    double dMeanBlock, dWorstBlock; // as a share of the deadline
+    uint64_t iMisses;
+    std::vector<float> loads;
+    std::vector<float> checksum;    // every output sample of the last track, for comparing runs
+};
+
+// iWorkers < 0 runs the tracks serially without the executor
+static Result runTracks(int iTracks, int iWorkers, float fSampleRate, int iBlockSize, float fSeconds)
+{
+    std::vector<std::unique_ptr<Track>> tracks = createTracks(iTracks, fSampleRate, iBlockSize);
+    std::unique_ptr<RealtimeExecutor> executor;
+    if(iWorkers >= 0) {
+        executor.reset(new RealtimeExecutor(iWorkers));
+        for(int t = 0; t < iTracks; t++)
+            for(Stage& stage : tracks[t]->stages)
+                executor->addJob(t, &Stage::run, &stage);
+    }
+
+    NoiseSource noise(777);
+    double dDeadline = iBlockSize / fSampleRate, dTotal = 0, dWorst = 0;
+    uint64_t iMisses = 0;
+    int iBlocks = (int)(fSeconds * fSampleRate / iBlockSize);
+    Result result;
+
+    for(int b = 0; b < iBlocks; b++) {
+        fillInputs(tracks, b * iBlockSize, iBlockSize, fSampleRate, noise);
+        for(auto& track : tracks)
+            track->stages[0].iCount = track->stages[1].iCount = iBlockSize;
+
+        Clock::time_point start = Clock::now();
+        if(executor)
+            executor->run(dDeadline);
+        else
+            for(auto& track : tracks)
+                for(Stage& stage : track->stages)
+                    Stage::run(&stage);
+        double dElapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        dTotal += dElapsed;
+        dWorst = std::max(dWorst, dElapsed);
+        iMisses += dElapsed > dDeadline;
+
+        for(int c = 0; c < 2; c++)
+            result.checksum.insert(result.checksum.end(), tracks.back()->output[c].begin(), tracks.back()->output[c].end());
+    }
+
+    result.dMeanBlock = dTotal / iBlocks / dDeadline;
+    result.dWorstBlock = dWorst / dDeadline;
+    result.iMisses = executor ? executor->getDeadlineMisses() : iMisses;
+    if(executor)
+        for(int w = 0; w < executor->getNumWorkers(); w++)
+            result.loads.push_back(executor->getWorkerLoad(w));
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    float fSampleRate = 48000, fSeconds = 2;
+    int iTracks = 32, iBlockSize = 64;
+    std::string sWorkers;
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--tracks" && bHasValue) iTracks = atoi(argv[++a]);
+        else if(sArg == "--workers" && bHasValue) sWorkers = argv[++a];
+        else if(sArg == "--rate" && bHasValue) fSampleRate = (float)atof(argv[++a]);
+        else if(sArg == "--block" && bHasValue) iBlockSize = atoi(argv[++a]);
+        else if(sArg == "--seconds" && bHasValue) fSeconds = (float)atof(argv[++a]);
+        else {
+            printf("usage: executor [--tracks N] [--workers LIST] [--rate HZ] [--block N] [--seconds S]\n"
+                   "  --workers LIST    comma-separated extra worker threads to try (default 0 up to the core count - 1)\n");
+            return sArg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::vector<int> workers;
+    if(sWorkers.empty()) {
+        int iCores = std::max(1u, std::thread::hardware_concurrency());
+        for(int w = 0; w < iCores; w++)
+            workers.push_back(w);
+    }
+    else {
+        std::stringstream stream(sWorkers);
+        std::string sItem;
+        while(std::getline(stream, sItem, ','))
+            workers.push_back(atoi(sItem.c_str()));
+    }
+
+    printf("%d tracks (gate -> delay), %d Hz, %d-sample blocks, %u cores\n", iTracks, (int)fSampleRate, iBlockSize,
+           std::thread::hardware_concurrency());
+    printf("threads    mean %%   worst %%   misses   output      load per thread %%\n");
+
+    Result serial = runTracks(iTracks, -1, fSampleRate, iBlockSize, fSeconds);
+    printf("serial   %8.1f %9.1f %8llu   reference\n", 100 * serial.dMeanBlock, 100 * serial.dWorstBlock,
+           (unsigned long long)serial.iMisses);
+
+    bool bOk = true;
+    for(int iWorkers : workers) {
+        Result result = runTracks(iTracks, iWorkers, fSampleRate, iBlockSize, fSeconds);
+        bool bSame = result.checksum == serial.checksum;
+        bOk = bOk && bSame;
+        printf("1 + %-4d %8.1f %9.1f %8llu   %-10s ", iWorkers, 100 * result.dMeanBlock, 100 * result.dWorstBlock,
+               (unsigned long long)result.iMisses, bSame ? "identical" : "DIFFERS");
+        for(float fLoad : result.loads)
+            printf(" %5.1f", 100 * fLoad);
+        printf("\n");
+    }
+    return bOk ? 0 : 1;
+}
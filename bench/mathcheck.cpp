@@ -0,0 +1,335 @@
+//
+//  mathcheck.cpp
+//  Accuracy Check for FastMath.h, TruePeak.h, PeakDetector.h, DelayLine.h and MultiTapDelay.h
+//
+//  Compares the scalar and block forms of the fast log2 / exp2 / dB functions against libm
+//  over their working ranges, prints the worst errors, and exits non-zero if any is outside
+//  the bounds documented in FastMath.h. Also runs the true-peak meter against the BS.1770
+//  filter worked in double precision, in blocks of awkward lengths, and checks that it finds
+//  the peak between the samples of a quarter-rate sine, and the sliding-window peak detector
+//  against a brute-force maximum over each window. Then the float16 conversions (every
+//  half must come back exactly, the block form must match the scalar one), the lookahead delay
+//  sample for sample, and the multi-tap delay's taps, sends and delay-time glides against the
+//  same reads interpolated in double precision straight from the input.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "FastMath.h"
+#include "TruePeak.h"
+#include "PeakDetector.h"
+#include "DelayLine.h"
+#include "MultiTapDelay.h"
+
+struct Check
+{
+    const char *sName;
+    double dWorst, dLimit;
+};
+
+static bool report(const Check& check)
+{
+    bool bPass = check.dWorst <= check.dLimit;
+    printf("%-28s worst %.3g (limit %.3g) %s\n", check.sName, check.dWorst, check.dLimit, bPass ? "ok" : "FAIL");
+    return bPass;
+}
+
+// signal[dPosition], interpolated linearly in double precision, with silence before the start
+static double interpolate(const std::vector<float>& signal, double dPosition)
+{
+    int k = (int)floor(dPosition);
+    double y0 = k < 0 ? 0 : signal[k], y1 = k + 1 < 0 ? 0 : signal[k + 1];
+    return y0 + (dPosition - k) * (y1 - y0);
+}
+
+// samples where the lookahead line is not exactly the input that many samples back. Blocks of 1
+// to 64 samples (every other one in place) go through a line a little over two blocks long, so
+// reads and writes keep wrapping in two segments, and the delay jumps between 0, its most and
+// in between part way through.
+static double delayLineMisses(const std::vector<float>& signal)
+{
+    const int piDelays[5] = { 0, 37, 100, 1, 64 };
+    DelayLine line;
+    line.setMaxDelay(100, 64);
+
+    std::vector<float> out(signal.size());
+    double dMisses = 0;
+    int iDone = 0, iBlock = 1;
+    while (iDone < (int)signal.size()) {
+        int iCount = std::min(iBlock, (int)signal.size() - iDone);
+        int iDelay = piDelays[iDone / 2999 % 5];
+        line.setDelay(iDelay);
+        if (iBlock % 2) {
+            std::copy(&signal[iDone], &signal[iDone] + iCount, &out[iDone]);
+            line.process(&out[iDone], &out[iDone], iCount);
+        }
+        else
+            line.process(&signal[iDone], &out[iDone], iCount);
+
+        for (int n = iDone; n < iDone + iCount; n++)
+            if (out[n] != (n - iDelay < 0 ? 0 : signal[n - iDelay]))
+                dMisses++;
+        iDone += iCount;
+        iBlock = iBlock * 5 % 64 + 1;
+    }
+    return dMisses;
+}
+
+// Worst difference between one tap gliding through whole and fractional delays, longer and
+// shorter, over ramps of different lengths (some set while one is under way), and the input read
+// at the same positions in double precision. The positions step as the line steps them, a float
+// step added each sample, landing on the new delay once the ramp is over; pfDrift gets how far
+// they strayed from the exact straight-line ramp, in samples.
+static double tapGlideError(const std::vector<float>& signal, double *pdDrift)
+{
+    const float pfTarget[6] = { 250.3f, 7.75f, 120, 299, 40.5f, 3 };
+    const int piRamp[6] = { 9000, 3001, 1, 5000, 777, 4000 };
+    MultiTapDelay line;
+    line.setMaxDelay(300, 64);
+    line.setTap(0, 40, 1, 1);
+
+    float fAt = 40, fTo = 40, fStep = 0;
+    double dFrom = 40;
+    int iRampStart = 0, iRampLength = 0;
+    std::vector<float> out(64), send(64);
+    double dWorst = 0;
+    *pdDrift = 0;
+    for (int iDone = 0, iGlide = 0; iDone < (int)signal.size(); ) {
+        if (iDone >= 6000 * iGlide + 1000 && iGlide < 6) {
+            dFrom = fAt;
+            fTo = pfTarget[iGlide];
+            fStep = (fTo - fAt) / piRamp[iGlide];
+            iRampStart = iDone;
+            iRampLength = piRamp[iGlide];
+            line.setTap(0, fTo, 1, 1, iRampLength);
+            iGlide++;
+        }
+        int iBlock = std::min(line.maxReadBlock(), (int)signal.size() - iDone);
+        line.read(out.data(), send.data(), iBlock);
+        line.write(&signal[iDone], iBlock);
+        for (int i = 0; i < iBlock; i++) {
+            int iStep = iDone + i - iRampStart + 1;
+            if (iStep <= iRampLength) {
+                fAt += fStep;
+                *pdDrift = fmax(*pdDrift, fabs(fAt - (dFrom + (fTo - dFrom) * iStep / iRampLength)));
+            }
+            dWorst = fmax(dWorst, fabs(out[i] - interpolate(signal, iDone + i - (double)fAt)));
+            if (iStep == iRampLength)
+                fAt = fTo;
+        }
+        iDone += iBlock;
+    }
+    return dWorst;
+}
+
+// worst difference between a three-tap line (whole, fractional and long delays, every gain and
+// send different) and the taps read straight from pfSignal, over the output and the send
+static double multiTapError(const std::vector<float>& signal, MultiTapDelay::Storage storage)
+{
+    const double pdDelay[3] = { 100, 37.25, 251.5 }, pdGain[3] = { 0.5, -0.25, 0.8 }, pdSend[3] = { 0.1, 0.6, 0 };
+    MultiTapDelay line;
+    line.setMaxDelay(300, 64, storage);
+    line.setTapCount(3);
+    for (int t = 0; t < 3; t++)
+        line.setTap(t, (float)pdDelay[t], (float)pdGain[t], (float)pdSend[t]);
+
+    std::vector<float> out(64), send(64);
+    double dWorst = 0;
+    for (int iDone = 0; iDone < (int)signal.size(); ) {
+        int iBlock = std::min(line.maxReadBlock(), (int)signal.size() - iDone);
+        const float *pfSend = line.read(out.data(), send.data(), iBlock);
+        line.write(&signal[iDone], iBlock);
+        for (int i = 0; i < iBlock; i++) {
+            double dOut = 0, dSend = 0;
+            for (int t = 0; t < 3; t++) {
+                double dTap = interpolate(signal, iDone + i - pdDelay[t]);
+                dOut += pdGain[t] * dTap;
+                dSend += pdSend[t] * dTap;
+            }
+            dWorst = fmax(dWorst, fmax(fabs(out[i] - dOut), fabs(pfSend[i] - dSend)));
+        }
+        iDone += iBlock;
+    }
+    return dWorst;
+}
+
+// samples where the detector's peak is not exactly the largest magnitude over the window ending
+// there, brute force. Fed in blocks of 1 to 300 samples (every other one in place), with the window
+// length changed mid-block every few thousand samples, and long enough for the history to wrap
+// round its ring many times.
+static double peakDetectorMisses(const std::vector<float>& signal)
+{
+    const int piLengths[6] = { 48, 1, 300, 3, 257, 100 };
+    PeakDetector detector;
+    detector.setMaxLength(300);
+    detector.setLength(piLengths[0]);
+
+    std::vector<float> peaks(signal.size());
+    double dMisses = 0;
+    int iDone = 0, iBlock = 1, iChange = 0, iLength = piLengths[0];
+    while (iDone < (int)signal.size()) {
+        int iCount = std::min(iBlock, (int)signal.size() - iDone);
+        if (iDone / 3001 != iChange) { // lands part way through a block
+            iChange = iDone / 3001;
+            iLength = piLengths[iChange % 6];
+            detector.setLength(iLength);
+        }
+        if (iBlock % 2) {
+            std::copy(&signal[iDone], &signal[iDone] + iCount, &peaks[iDone]);
+            detector.process(&peaks[iDone], &peaks[iDone], iCount);
+        }
+        else
+            detector.process(&signal[iDone], &peaks[iDone], iCount);
+
+        for (int n = iDone; n < iDone + iCount; n++) {
+            float fPeak = 0;
+            for (int k = std::max(0, n - iLength + 1); k <= n; k++)
+                fPeak = std::max(fPeak, fabsf(signal[k]));
+            if (peaks[n] != fPeak)
+                dMisses++;
+        }
+        iDone += iCount;
+        iBlock = iBlock * 7 % 301 + 1;
+    }
+    return dMisses;
+}
+
+int main()
+{
+    // log-spaced gains from -180 to +60 dB, and linear sweeps of exp2 and dB arguments
+    std::vector<float> gains, exponents, decibels;
+    for (int i = 0; i <= 200000; i++) {
+        gains.push_back((float)pow(10.0, -9.0 + 12.0 * i / 200000));
+        exponents.push_back((float)(-126.0 + 253.0 * i / 200000));
+        decibels.push_back((float)(-140.0 + 164.0 * i / 200000));
+    }
+
+    int iCount = (int)gains.size();
+    std::vector<float> block(iCount);
+    Check log2Scalar = { "log2 (abs)", 0, 4e-6 }, log2Block = { "log2 block (abs)", 0, 4e-6 };
+    Check exp2Scalar = { "exp2 (rel)", 0, 2e-7 }, exp2Block = { "exp2 block (rel)", 0, 2e-7 };
+    Check dbScalar = { "gainToDb (abs dB)", 0, 4e-5 }, dbBlock = { "gainToDb block (abs dB)", 0, 4e-5 };
+    Check gainScalar = { "dbToGain (rel)", 0, 1e-6 }, gainBlock = { "dbToGain block (rel)", 0, 1e-6 };
+    Check log10Scalar = { "log10 (abs)", 0, 2e-6 };
+
+    fastmath::log2(gains.data(), block.data(), iCount);
+    for (int i = 0; i < iCount; i++) {
+        double dRef = std::log2((double)gains[i]);
+        log2Scalar.dWorst = fmax(log2Scalar.dWorst, fabs(fastmath::log2(gains[i]) - dRef));
+        log2Block.dWorst = fmax(log2Block.dWorst, fabs(block[i] - dRef));
+        log10Scalar.dWorst = fmax(log10Scalar.dWorst, fabs(fastmath::log10(gains[i]) - std::log10((double)gains[i])));
+    }
+
+    fastmath::gainToDb(gains.data(), block.data(), iCount);
+    for (int i = 0; i < iCount; i++) {
+        double dRef = 20.0 * std::log10((double)gains[i]);
+        dbScalar.dWorst = fmax(dbScalar.dWorst, fabs(fastmath::gainToDb(gains[i]) - dRef));
+        dbBlock.dWorst = fmax(dbBlock.dWorst, fabs(block[i] - dRef));
+    }
+
+    fastmath::exp2(exponents.data(), block.data(), iCount);
+    for (int i = 0; i < iCount; i++) {
+        double dRef = std::exp2((double)exponents[i]);
+        exp2Scalar.dWorst = fmax(exp2Scalar.dWorst, fabs(fastmath::exp2(exponents[i]) - dRef) / dRef);
+        exp2Block.dWorst = fmax(exp2Block.dWorst, fabs(block[i] - dRef) / dRef);
+    }
+
+    fastmath::dbToGain(decibels.data(), block.data(), iCount);
+    for (int i = 0; i < iCount; i++) {
+        double dRef = std::pow(10.0, decibels[i] / 20.0);
+        gainScalar.dWorst = fmax(gainScalar.dWorst, fabs(fastmath::dbToGain(decibels[i]) - dRef) / dRef);
+        gainBlock.dWorst = fmax(gainBlock.dWorst, fabs(block[i] - dRef) / dRef);
+    }
+
+    // oversampled peaks of a second of noise with bursts near full scale, fed in blocks of 1 to 300
+    // samples, against the same oversampler in double precision over the whole signal
+    Check truePeakBlocks = { "true peak blocks (abs)", 0, 1e-6 }, truePeakSine = { "true peak sine (abs)", 0, 0.02 };
+    std::vector<float> signal(48000);
+    unsigned uNoise = 1;
+    for (size_t n = 0; n < signal.size(); n++) {
+        uNoise = uNoise * 1664525u + 1013904223u;
+        signal[n] = (float)((int)uNoise / 2147483648.0) * ((n / 4000) % 2 ? 0.99f : 0.1f);
+    }
+    {
+        TruePeak meter;
+        std::vector<float> peaks(signal.size());
+        int iDone = 0, iLength = 1;
+        while (iDone < (int)signal.size()) {
+            int iBlock = std::min(iLength, (int)signal.size() - iDone);
+            meter.process(&signal[iDone], &peaks[iDone], iBlock);
+            iDone += iBlock;
+            iLength = iLength * 7 % 301 + 1;
+        }
+        for (int n = 0; n < (int)signal.size(); n++) {
+            double dRef = 0;
+            for (int p = 0; p < TruePeak::kPhases; p++) {
+                double dSum = 0;
+                for (int k = 0; k < TruePeak::kTaps && k <= n; k++)
+                    dSum += (double)TruePeak::taps()[p * TruePeak::kTaps + k] * signal[n - k];
+                dRef = fmax(dRef, fabs(dSum));
+            }
+            truePeakBlocks.dWorst = fmax(truePeakBlocks.dWorst, fabs(peaks[n] - dRef));
+        }
+    }
+
+    // a full-scale sine at a quarter of the sample rate, sampled 45 degrees off its peaks: the
+    // samples read 0.707, the waveform between them reaches 1
+    {
+        std::vector<float> sine(4800);
+        for (size_t n = 0; n < sine.size(); n++)
+            sine[n] = (float)sin(M_PI / 2 * n + M_PI / 4);
+        std::vector<float> peaks(sine.size());
+        TruePeak meter;
+        meter.process(sine.data(), peaks.data(), (int)sine.size());
+        truePeakSine.dWorst = fabs(*std::max_element(peaks.begin() + 100, peaks.end()) - 1.0); //after the filter has settled
+    }
+
+    Check peakDetector = { "peak detector (misses)", peakDetectorMisses(signal), 0 };
+
+    // every half that is not a NaN back and forth (scalar and block), then floats from the
+    // subnormal halves up rounded to halves, alike both ways and, over the normal range, within
+    // half a unit in the last place
+    Check halfExact = { "float16 round trip (misses)", 0, 0 }, halfRounding = { "float16 rounding (rel)", 0, 1.0 / 2048 };
+    {
+        std::vector<uint16_t> halves, back(65536);
+        for (int h = 0; h < 65536; h++)
+            if ((h & 0x7C00) != 0x7C00 || (h & 0x3FF) == 0)
+                halves.push_back((uint16_t)h);
+        std::vector<float> floats(halves.size());
+        simd::fromHalf(halves.data(), floats.data(), (int)halves.size());
+        simd::toHalf(floats.data(), back.data(), (int)halves.size());
+        for (size_t h = 0; h < halves.size(); h++)
+            if (back[h] != halves[h] || simd::toHalf(simd::fromHalf(halves[h])) != halves[h] || floats[h] != simd::fromHalf(halves[h]))
+                halfExact.dWorst++;
+
+        std::vector<float> values;
+        for (int i = 0; i <= 200000; i++)
+            values.push_back((float)pow(2.0, -26.0 + 41.9 * i / 200000) * (i % 2 ? -1 : 1));
+        std::vector<uint16_t> rounded(values.size());
+        simd::toHalf(values.data(), rounded.data(), (int)values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            if (rounded[i] != simd::toHalf(values[i]))
+                halfExact.dWorst++;
+            if (fabs(values[i]) >= 6.103515625e-05) // 2^-14
+                halfRounding.dWorst = fmax(halfRounding.dWorst, fabs(simd::fromHalf(rounded[i]) - values[i]) / fabs(values[i]));
+        }
+    }
+
+    // the noise bursts through three taps, stored as floats (rounding only) and as halves
+    // (within half a unit of each sample per tap: 0.99 * 2^-11 * the gains' 1.55)
+    Check multiTapFloat = { "multi-tap delay (abs)", multiTapError(signal, MultiTapDelay::FLOAT32), 1e-6 };
+    Check multiTapHalf = { "multi-tap float16 (abs)", multiTapError(signal, MultiTapDelay::FLOAT16), 7.5e-4 };
+    Check tapGlide = { "delay glide (abs)", 0, 1e-6 }, tapDrift = { "delay glide drift (samples)", 0, 0.05 };
+    tapGlide.dWorst = tapGlideError(signal, &tapDrift.dWorst);
+    Check delayLine = { "lookahead delay (misses)", delayLineMisses(signal), 0 };
+
+    bool bPass = true;
+    for (const Check *pCheck : { &log2Scalar, &log2Block, &log10Scalar, &dbScalar, &dbBlock, &exp2Scalar, &exp2Block, &gainScalar, &gainBlock,
+                                 &truePeakBlocks, &truePeakSine, &peakDetector, &halfExact, &halfRounding, &multiTapFloat, &multiTapHalf,
+                                 &tapGlide, &tapDrift, &delayLine })
+        bPass = report(*pCheck) && bPass;
+    return bPass ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+//
+//  pcm.cpp
+//  Integer PCM Benchmark
+//
+//  Times MyEffect on interleaved integer PCM three ways: as the host used to run it, with a
+//  per-sample pass converting each block to float and deinterleaving it before process() and
+//  another pass back after; with the PcmKernels.h kernels as those passes; and with processPcm(),
+//  which converts inside the engine an internal block at a time. Also checks the kernels against
+//  the per-sample conversion (bit for bit, dither included), that an int16 or int24 round trip
+//  without dither gives back the same integers, and that all three write exactly the same output.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EffectPlugin.h"
+#include "Signals.h"
+
+extern "C" CREATE_FUNCTION createEffect(float sampleRate);
+
+typedef std::chrono::steady_clock Clock;
+typedef std::vector<uint8_t> Bytes;
+
+static const pcm::Format kFormats[3] = { pcm::INT16, pcm::INT24, pcm::INT32 };
+static const char* const kFormatNames[3] = { "int16", "int24", "int32" };
+
+static int bits(pcm::Format format) { return 8 * pcm::bytesPerSample(format); }
+
+// one sample at a time, the way the host converted: little-endian integers, full scale +-1
+static int32_t loadSample(pcm::Format format, const uint8_t *p)
+{
+    int iBytes = pcm::bytesPerSample(format);
+    uint32_t u = 0;
+    for(int b = 0; b < iBytes; b++)
+        u |= (uint32_t)p[b] << (8 * (4 - iBytes + b));
+    return (int32_t)u >> (8 * (4 - iBytes));
+}
+
+static void storeSample(pcm::Format format, uint8_t *p, int32_t i)
+{
+    for(int b = 0; b < pcm::bytesPerSample(format); b++)
+        p[b] = (uint8_t)(i >> (8 * b));
+}
+
+static void referenceRead(pcm::Format format, const uint8_t *pIn, int iChannels, float* const* ppOut, int iFrames)
+{
+    int iBytes = pcm::bytesPerSample(format);
+    float fScale = ldexpf(1, bits(format) - 1);
+    for(int f = 0; f < iFrames; f++)
+        for(int c = 0; c < iChannels; c++)
+            ppOut[c][f] = (float)loadSample(format, pIn + (f * iChannels + c) * iBytes) / fScale;
+}
+
+static void referenceWrite(const float* const* ppIn, int iChannels, pcm::Format format, uint8_t *pOut, int iFrames, pcm::Dither *pDither)
+{
+    int iBytes = pcm::bytesPerSample(format);
+    float fScale = ldexpf(1, bits(format) - 1);
+    float fMax = format == pcm::INT32 ? 2147483520.0f : fScale - 1;
+    bool bDither = pDither && format != pcm::INT32;
+    for(int f = 0, n = 0; f < iFrames; f++)
+        for(int c = 0; c < iChannels; c++, n++) {
+            float fSample = ppIn[c][f] * fScale + (bDither ? pDither->next(n % pcm::Dither::kLanes) : 0);
+            fSample = std::max(std::min(fSample, fMax), -fScale);
+            storeSample(format, pOut + (f * iChannels + c) * iBytes, (int32_t)nearbyintf(fSample));
+        }
+}
+
+// iFrames of random full-range samples
+static Bytes randomPcm(pcm::Format format, int iChannels, int iFrames, NoiseSource& noise)
+{
+    Bytes bytes(iFrames * iChannels * pcm::bytesPerSample(format));
+    for(size_t b = 0; b < bytes.size(); b++)
+        bytes[b] = (uint8_t)(noise.next() * 128 + 128);
+    return bytes;
+}
+
+// the kernels against the per-sample conversion for every format, a few channel counts and
+// lengths that leave every remainder; returns the number of mismatches
+static int checkKernels()
+{
+    const int piChannels[4] = { 1, 2, 3, 6 }, piFrames[5] = { 1, 7, 13, 256, 1001 };
+    NoiseSource noise(777);
+    int iFailures = 0;
+
+    for(int k = 0; k < 3; k++)
+        for(int iChannels : piChannels)
+            for(int iFrames : piFrames) {
+                pcm::Format format = kFormats[k];
+                Bytes in = randomPcm(format, iChannels, iFrames, noise);
+                std::vector<std::vector<float>> kernel(iChannels, std::vector<float>(iFrames)), reference(kernel);
+                std::vector<float*> ppKernel, ppReference;
+                for(int c = 0; c < iChannels; c++) {
+                    ppKernel.push_back(kernel[c].data());
+                    ppReference.push_back(reference[c].data());
+                }
+
+                pcm::read(format, in.data(), iChannels, ppKernel.data(), iFrames);
+                referenceRead(format, in.data(), iChannels, ppReference.data(), iFrames);
+                bool bRead = kernel == reference;
+
+                //undithered, the integers come back as they went in (int32 has more bits than a float holds)
+                Bytes out(in.size()), expected(in.size());
+                pcm::write(ppKernel.data(), iChannels, format, out.data(), iFrames, nullptr);
+                bool bRoundTrip = format == pcm::INT32 || out == in;
+
+                //dithered, and pushed past full scale so the clipping is exercised, over two calls
+                for(int c = 0; c < iChannels; c++)
+                    for(int f = 0; f < iFrames; f++)
+                        kernel[c][f] = reference[c][f] = kernel[c][f] * 1.5f + 1e-6f * noise.next();
+                pcm::Dither kernelDither, referenceDither;
+                for(int r = 0; r < 2; r++) {
+                    pcm::write(ppKernel.data(), iChannels, format, out.data(), iFrames, &kernelDither);
+                    referenceWrite(ppReference.data(), iChannels, format, expected.data(), iFrames, &referenceDither);
+                }
+                bool bWrite = out == expected;
+
+                if(!bRead || !bRoundTrip || !bWrite) {
+                    printf("  %s, %d channels, %d frames:%s%s%s\n", kFormatNames[k], iChannels, iFrames,
+                           bRead ? "" : " read differs", bRoundTrip ? "" : " round trip differs", bWrite ? "" : " write differs");
+                    iFailures++;
+                }
+            }
+    return iFailures;
+}
+
+static std::unique_ptr<MyEffect> makeEffect(float fSampleRate)
+{
+    std::unique_ptr<MyEffect> effect((MyEffect*)createEffect(fSampleRate));
+    for(int p = 0; p < effect->getNumParameters(); p++)
+        if(effect->getControl(p).type == APDI::Parameter::MENU)
+            effect->setParameter(p, effect->getParameter(p));
+    const std::pair<int, float> full[] = { {2, -40}, {3, -6}, {4, 2}, {5, 50}, {6, 80}, {7, -60},
+                                           {8, 1}, {11, 800}, {13, 0.4f}, {14, 200}, {15, 60}, {16, 100} };
+    for(const auto& value : full)
+        effect->setParameter(value.first, value.second);
+    return effect;
+}
+
+// the host's way: convert and deinterleave a block, process() it, convert it back, with its
+// per-sample loops or (bKernels) with the kernels as separate passes
+static double runSeparate(const Bytes& in, pcm::Format inFormat, Bytes& out, pcm::Format outFormat, float fSampleRate, int iBlockSize, bool bKernels)
+{
+    std::unique_ptr<MyEffect> effect = makeEffect(fSampleRate);
+    int iFrames = (int)in.size() / (2 * pcm::bytesPerSample(inFormat));
+    std::vector<float> pfL(iBlockSize), pfR(iBlockSize);
+    float *ppBlock[2] = { pfL.data(), pfR.data() };
+    pcm::Dither dither;
+
+    Clock::time_point start = Clock::now();
+    for(int iPos = 0; iPos < iFrames; iPos += iBlockSize) {
+        int iCount = std::min(iBlockSize, iFrames - iPos);
+        const uint8_t *pIn = in.data() + 2 * iPos * pcm::bytesPerSample(inFormat);
+        uint8_t *pOut = out.data() + 2 * iPos * pcm::bytesPerSample(outFormat);
+        if(bKernels) pcm::read(inFormat, pIn, 2, ppBlock, iCount);
+        else referenceRead(inFormat, pIn, 2, ppBlock, iCount);
+        effect->process((const float**)ppBlock, ppBlock, iCount);
+        if(bKernels) pcm::write(ppBlock, 2, outFormat, pOut, iCount, &dither);
+        else referenceWrite(ppBlock, 2, outFormat, pOut, iCount, &dither);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double runFused(const Bytes& in, pcm::Format inFormat, Bytes& out, pcm::Format outFormat, float fSampleRate, int iBlockSize)
+{
+    std::unique_ptr<MyEffect> effect = makeEffect(fSampleRate);
+    int iFrames = (int)in.size() / (2 * pcm::bytesPerSample(inFormat));
+
+    Clock::time_point start = Clock::now();
+    for(int iPos = 0; iPos < iFrames; iPos += iBlockSize) {
+        int iCount = std::min(iBlockSize, iFrames - iPos);
+        effect->processPcm(in.data() + 2 * iPos * pcm::bytesPerSample(inFormat), inFormat,
+                           out.data() + 2 * iPos * pcm::bytesPerSample(outFormat), outFormat, iCount);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    float fSampleRate = 48000, fSeconds = 10;
+    int iBlockSize = 256, iPasses = 5;
+    std::string sSignal = "speech";
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--rate" && bHasValue) fSampleRate = (float)atof(argv[++a]);
+        else if(sArg == "--block" && bHasValue) iBlockSize = std::max(4, atoi(argv[++a]) & ~3);
+        else if(sArg == "--seconds" && bHasValue) fSeconds = (float)atof(argv[++a]);
+        else if(sArg == "--signal" && bHasValue) sSignal = argv[++a];
+        else if(sArg == "--passes" && bHasValue) iPasses = std::max(1, atoi(argv[++a]));
+        else {
+            printf("usage: pcm [--rate HZ] [--block N] [--seconds S] [--signal NAME] [--passes N]\n"
+                   "  --block N   frames per call, a multiple of 4 so both ways dither alike (default 256)\n");
+            return sArg == "--help" ? 0 : 1;
+        }
+    }
+
+    int iFailures = checkKernels();
+    if(iFailures == 0) printf("kernels against per-sample conversion: identical\n");
+    else printf("kernels against per-sample conversion: %d cases DIFFER\n", iFailures);
+
+    AudioData audio;
+    if(!makeSignal(sSignal, fSampleRate, fSeconds, audio)) {
+        fprintf(stderr, "pcm: unknown signal '%s'\n", sSignal.c_str());
+        return 1;
+    }
+    int iFrames = (int)audio.channels[0].size();
+    const float *ppAudio[2] = { audio.channels[0].data(), audio.channels[1].data() };
+
+    printf("\n%s, %d Hz, %d-frame blocks, best of %d\n", sSignal.c_str(), (int)fSampleRate, iBlockSize, iPasses);
+    printf("us per second of audio: separate per-sample passes, separate kernel passes, processPcm()\n");
+    printf("format        per-sample   kernels     fused   speedup   output\n");
+
+    bool bOk = iFailures == 0;
+    for(int k = 0; k < 3; k++) {
+        pcm::Format format = kFormats[k];
+        Bytes in(iFrames * 2 * pcm::bytesPerSample(format)), separate(in.size()), passes(in.size()), fused(in.size());
+        pcm::write(ppAudio, 2, format, in.data(), iFrames, nullptr);
+
+        double dSeparate = 1e9, dPasses = 1e9, dFused = 1e9;
+        for(int p = 0; p < iPasses; p++) {
+            dSeparate = std::min(dSeparate, runSeparate(in, format, separate, format, fSampleRate, iBlockSize, false));
+            dPasses = std::min(dPasses, runSeparate(in, format, passes, format, fSampleRate, iBlockSize, true));
+            dFused = std::min(dFused, runFused(in, format, fused, format, fSampleRate, iBlockSize));
+        }
+        bool bSame = separate == fused && passes == fused;
+        bOk = bOk && bSame;
+        printf("%-5s in/out %11.1f %9.1f %9.1f %8.2fx   %s\n", kFormatNames[k], 1e6 * dSeparate / fSeconds, 1e6 * dPasses / fSeconds,
+               1e6 * dFused / fSeconds, dSeparate / dFused, bSame ? "identical" : "DIFFERS");
+    }
+    return bOk ? 0 : 1;
+}
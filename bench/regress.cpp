@@ -0,0 +1,402 @@
+//
+//  regress.cpp
+//  Golden-Output and Performance Regression Suite
+//
+//  Renders fixed test signals (noise bursts, speech, a sine and silence) through a grid of
+//  settings: every filter type with fast, slow, lookahead and unlinked gating, each dry and with
+//  the echo, plus the multiband gate. `--record` stores a compact reference for each output -
+//  the lowest and highest sample and the RMS of each channel over every 100 ms - in
+//  references.txt, which is kept in git, and the cost per sample of every configuration in the
+//  cost directory, which is not. Without it, every output is compared to its reference and every
+//  cost to the recorded one, and the run fails (exit 1) if an output has drifted by more than the
+//  tolerance, a configuration has got slower by more than the threshold, process() allocated, or
+//  the output changes when the host calls it with odd, uneven block sizes instead of 256. It also
+//  checks that the L / R meters rise on a tone and fall at the usual rate after it.
+//
+//  Record the references on a known-good build (`make golden`) and commit references.txt when an
+//  output is meant to change; check a change against them (`make regression`). Costs are only
+//  comparable on the machine that recorded them, so a fresh checkout checks the outputs alone
+//  until it has recorded its own.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "apdi/Plugin.h"
+#include "apdi/Helpers.h"
+#include "AllocationCounter.h"
+#include "ParameterSets.h"
+#include "Signals.h"
+
+extern "C" CREATE_FUNCTION createEffect(float sampleRate);
+
+static const float kSampleRate = 48000;
+static const float kSeconds = 3;
+static const int kBlockSize = 256;
+static const int kWindow = 4800; // samples per reference window, 100 ms
+static const std::vector<int> kOddBlocks = { 37, 500, 1, 129, 1000 }; // host calls of these sizes in turn must give the same output
+
+// the settings grid: { name, control values }, named filter-gate-delay
+static std::vector<ParameterSet> configurations()
+{
+    typedef std::vector<std::pair<int, float>> Values;
+    const std::pair<const char*, Values> filters[] = {
+        { "bp", { {8, 0}, {11, 1000}, {12, 800} } },
+        { "lp", { {8, 1}, {9, 500} } },
+        { "hp", { {8, 2}, {10, 2000} } },
+    };
+    const std::pair<const char*, Values> gates[] = {
+        { "fast",      { {2, -40}, {3, -6}, {4, 1}, {5, 20}, {6, 20}, {7, -80} } },
+        { "slow",      { {2, -30}, {3, -10}, {4, 20}, {5, 200}, {6, 80}, {7, -40} } },
+        { "lookahead", { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {17, 5}, {18, 5} } },
+        { "unlinked",  { {2, -40}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -60}, {19, 1} } },
+    };
+    const std::pair<const char*, Values> delays[] = {
+        { "dry",  { {13, 0}, {15, 0}, {16, 100} } },
+        { "echo", { {13, 0.5f}, {14, 250}, {15, 100}, {16, 100} } },
+    };
+
+    std::vector<ParameterSet> sets;
+    for(const auto& delay : delays) {
+        for(const auto& filter : filters) {
+            for(const auto& gate : gates) {
+                ParameterSet set;
+                set.name = std::string(filter.first) + "-" + gate.first + "-" + delay.first;
+                set.values = filter.second;
+                set.values.insert(set.values.end(), gate.second.begin(), gate.second.end());
+                set.values.insert(set.values.end(), delay.second.begin(), delay.second.end());
+                sets.push_back(set);
+            }
+        }
+        ParameterSet multiband;
+        multiband.name = std::string("multiband-") + delay.first;
+        multiband.values = { {2, -50}, {3, -6}, {4, 5}, {5, 50}, {6, 50}, {7, -30}, {20, 1} };
+        multiband.values.insert(multiband.values.end(), delay.second.begin(), delay.second.end());
+        sets.push_back(multiband);
+    }
+    return sets;
+}
+
+// creates an instance the way the host would: set the rate, create, then push every control
+static std::unique_ptr<APDI::Effect> createInstance(const ParameterSet& set)
+{
+    stk::Stk::setSampleRate(kSampleRate);
+    std::unique_ptr<APDI::Effect> effect(createEffect(kSampleRate));
+
+    for(int p = 0; p < effect->getNumParameters(); p++)
+        if(effect->getControl(p).type == APDI::Parameter::MENU)
+            effect->setParameter(p, effect->getParameter(p)); // host announces the initial menu items
+    for(const auto& value : set.values)
+        effect->setParameter(value.first, value.second);
+
+    return effect;
+}
+
+// renders the whole input through a fresh instance in blocks of each of the sizes in turn
+// (kBlockSize unless given); returns ns per sample
+static double render(const ParameterSet& set, const AudioData& input, AudioData& output, long& iAllocations,
+                     const std::vector<int>& blocks = { kBlockSize })
+{
+    typedef std::chrono::steady_clock Clock;
+    std::unique_ptr<APDI::Effect> effect = createInstance(set);
+
+    int iFrames = input.numFrames(), iMaxBlock = *std::max_element(blocks.begin(), blocks.end());
+    std::vector<float> inL(iMaxBlock), inR(iMaxBlock), outL(iMaxBlock), outR(iMaxBlock);
+    const float *ppIn[2] = { inL.data(), inR.data() };
+    float *ppOut[2] = { outL.data(), outR.data() };
+    output.fSampleRate = input.fSampleRate;
+    output.channels.assign(2, std::vector<float>(iFrames));
+
+    Clock::duration total(0);
+    AllocationCounter::clear();
+    for(int iPos = 0, b = 0; iPos < iFrames; iPos += blocks[b], b = (b + 1) % blocks.size()) {
+        int iCount = std::min(blocks[b], iFrames - iPos);
+        std::copy(input.channels[0].begin() + iPos, input.channels[0].begin() + iPos + iCount, inL.begin());
+        std::copy(input.channels[1].begin() + iPos, input.channels[1].begin() + iPos + iCount, inR.begin());
+
+        Clock::time_point start = Clock::now();
+        {
+            AllocationCounter::Scope counting;
+            effect->process(ppIn, ppOut, iCount);
+        }
+        total += Clock::now() - start;
+
+        std::copy(outL.begin(), outL.begin() + iCount, output.channels[0].begin() + iPos);
+        std::copy(outR.begin(), outR.begin() + iCount, output.channels[1].begin() + iPos);
+    }
+    iAllocations = AllocationCounter::getCount();
+    return std::chrono::duration<double, std::nano>(total).count() / std::max(iFrames, 1);
+}
+
+// The L / R meters, which process() writes itself: a tone must bring both up to its level, and
+// in the silence after it they must fall by 0.99 every 1 ms window. Returns what went wrong, if
+// anything.
+static std::string checkMeters()
+{
+    const int iBlock = 480, iWindow = 48; // ten measuring windows a block at 48 kHz
+    ParameterSet set = { "meters", { {15, 0} } }; // no echo, so the output stops with the tone
+    std::unique_ptr<APDI::Effect> effect = createInstance(set);
+
+    std::vector<float> inL(iBlock), inR(iBlock), outL(iBlock), outR(iBlock);
+    const float *ppIn[2] = { inL.data(), inR.data() };
+    float *ppOut[2] = { outL.data(), outR.data() };
+    std::string sProblems;
+
+    //half a second of a 1 kHz tone at half scale, whose meter level is log10(0.5 * 39 + 1) / log10(40)
+    for(int b = 0, iPos = 0; b < 50; b++) {
+        for(int i = 0; i < iBlock; i++, iPos++)
+            inL[i] = inR[i] = 0.5f * (float)sin(2 * 3.14159265358979 * 1000 * iPos / kSampleRate);
+        effect->process(ppIn, ppOut, iBlock);
+    }
+    double dToneLevel = log10(0.5 * 39 + 1) / log10(40.0);
+    for(int c = 0; c < 2; c++)
+        if(fabs(effect->getParameter(c) - dToneLevel) > 0.01)
+            sProblems += "tone-level ";
+
+    //then silence: after a block for the filters to ring down, each block of ten windows takes
+    //the level down by 0.99^10 (to float rounding)
+    std::fill(inL.begin(), inL.end(), 0.f);
+    std::fill(inR.begin(), inR.end(), 0.f);
+    effect->process(ppIn, ppOut, iBlock);
+    double dDecay = pow(0.99, iBlock / iWindow);
+    for(int b = 0; b < 100 && sProblems.find("decay") == std::string::npos; b++) {
+        float pfBefore[2] = { effect->getParameter(0), effect->getParameter(1) };
+        effect->process(ppIn, ppOut, iBlock);
+        for(int c = 0; c < 2; c++)
+            if(!(pfBefore[c] > 0) || fabs(effect->getParameter(c) / pfBefore[c] - dDecay) > 1e-5)
+                sProblems += "decay ";
+    }
+    return sProblems;
+}
+
+// the compact reference for an output: for every kWindow samples (the last window may be
+// shorter), the lowest sample, the highest and the RMS of each channel in turn
+static std::vector<double> summarise(const AudioData& audio)
+{
+    std::vector<double> summary;
+    for(int iStart = 0; iStart < audio.numFrames(); iStart += kWindow) {
+        int iEnd = std::min(iStart + kWindow, audio.numFrames());
+        for(const std::vector<float>& channel : audio.channels) {
+            double dLow = channel[iStart], dHigh = channel[iStart], dSquares = 0;
+            for(int f = iStart; f < iEnd; f++) {
+                dLow = std::min(dLow, (double)channel[f]);
+                dHigh = std::max(dHigh, (double)channel[f]);
+                dSquares += (double)channel[f] * channel[f];
+            }
+            summary.push_back(dLow);
+            summary.push_back(dHigh);
+            summary.push_back(sqrt(dSquares / (iEnd - iStart)));
+        }
+    }
+    return summary;
+}
+
+// the largest difference between two summaries, or -1 if their shapes differ
+static double maxDifference(const std::vector<double>& a, const std::vector<double>& b)
+{
+    if(a.size() != b.size())
+        return -1;
+    double dMax = 0;
+    for(size_t i = 0; i < a.size(); i++)
+        dMax = std::max(dMax, fabs(a[i] - b[i]));
+    return dMax;
+}
+
+// FNV-1a over the sample bits, to check that every pass renders the same output
+static uint64_t hashOutput(const AudioData& audio)
+{
+    uint64_t uHash = 14695981039346656037ull;
+    for(const std::vector<float>& channel : audio.channels) {
+        const unsigned char *pBytes = reinterpret_cast<const unsigned char*>(channel.data());
+        for(size_t i = 0; i < channel.size() * sizeof(float); i++)
+            uHash = (uHash ^ pBytes[i]) * 1099511628211ull;
+    }
+    return uHash;
+}
+
+static void usage()
+{
+    printf("usage: regress [options]\n"
+           "  --record          store the outputs and costs as the new references\n"
+           "  --references FILE output references, kept in git (default references.txt)\n"
+           "  --dir DIR         cost directory, local to the machine (default golden)\n"
+           "  --tolerance T     largest allowed sample difference from a reference (default 1e-5)\n"
+           "  --slowdown PCT    largest allowed increase in cost per sample (default 25)\n"
+           "  --passes N        timed renders per configuration, the median counts (default 7)\n"
+           "  --no-timing       check the outputs only\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string sDir = "golden", sReferences = "references.txt";
+    bool bRecord = false, bTiming = true;
+    double dTolerance = 1e-5, dSlowdown = 25;
+    int iPasses = 7;
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--record") bRecord = true;
+        else if(sArg == "--no-timing") bTiming = false;
+        else if(sArg == "--dir" && bHasValue) sDir = argv[++a];
+        else if(sArg == "--references" && bHasValue) sReferences = argv[++a];
+        else if(sArg == "--tolerance" && bHasValue) dTolerance = atof(argv[++a]);
+        else if(sArg == "--slowdown" && bHasValue) dSlowdown = atof(argv[++a]);
+        else if(sArg == "--passes" && bHasValue) iPasses = std::max(1, atoi(argv[++a]));
+        else { usage(); return sArg == "--help" ? 0 : 1; }
+    }
+
+    //recorded costs, one "signal/configuration ns" per line, and output references, one
+    //"signal/configuration count value..." per line
+    std::string sCosts = sDir + "/costs.txt";
+    std::map<std::string, double> recorded;
+    std::map<std::string, std::vector<double>> references;
+    if(bRecord)
+        mkdir(sDir.c_str(), 0755);
+    else {
+        std::ifstream file(sCosts);
+        std::string sName;
+        double dCost;
+        while(file >> sName >> dCost)
+            recorded[sName] = dCost;
+
+        std::ifstream referenceFile(sReferences);
+        size_t uCount;
+        while(referenceFile >> sName >> uCount) {
+            std::vector<double>& summary = references[sName];
+            summary.resize(uCount);
+            for(double& dValue : summary)
+                referenceFile >> dValue;
+        }
+    }
+    std::ofstream costFile, referenceFile;
+    if(bRecord) {
+        costFile.open(sCosts);
+        referenceFile.open(sReferences);
+        if(!costFile || !referenceFile) {
+            fprintf(stderr, "regress: cannot write %s\n", !costFile ? sCosts.c_str() : sReferences.c_str());
+            return 1;
+        }
+    }
+
+    //every configuration is checked on the first pass; later passes go round them all again, so
+    //a slow spell on the machine costs one pass of a few configurations rather than all of theirs
+    const char* const signals[] = { "bursts", "speech", "sine", "silence" };
+    std::vector<ParameterSet> sets = configurations();
+    std::vector<AudioData> inputs(sizeof signals / sizeof *signals);
+    for(size_t i = 0; i < inputs.size(); i++)
+        makeSignal(signals[i], kSampleRate, kSeconds, inputs[i]);
+
+    struct Run {
+        std::string sName, sResult;
+        const ParameterSet *pSet;
+        const AudioData *pInput;
+        std::vector<double> costs;
+        double dCost, dDiff;
+        uint64_t uHash;
+        std::vector<double> summary;
+    };
+    std::vector<Run> runs;
+    for(size_t i = 0; i < inputs.size(); i++)
+        for(const ParameterSet& set : sets)
+            runs.push_back({ std::string(signals[i]) + "/" + set.name, "", &set, &inputs[i], {}, 0, -1, 0, {} });
+
+    for(int p = 0; p < (bTiming ? iPasses : 1); p++) {
+        for(Run& run : runs) {
+            AudioData output;
+            long iAllocations = 0;
+            double dCost = render(*run.pSet, *run.pInput, output, iAllocations);
+            uint64_t uHash = hashOutput(output);
+
+            if(iAllocations > 0 && run.sResult.find("allocates") == std::string::npos)
+                run.sResult += "allocates ";
+            run.costs.push_back(dCost);
+            if(p == 0) {
+                run.uHash = uHash;
+
+                //the internal blocks keep to their own grid, so the host's block size makes no difference
+                AudioData odd;
+                long iOddAllocations = 0;
+                render(*run.pSet, *run.pInput, odd, iOddAllocations, kOddBlocks);
+                if(hashOutput(odd) != uHash)
+                    run.sResult += "block-dependent ";
+
+                run.summary = summarise(output);
+                if(!bRecord) {
+                    auto reference = references.find(run.sName);
+                    if(reference == references.end())
+                        run.sResult += "no-reference ";
+                    else if((run.dDiff = maxDifference(run.summary, reference->second)) < 0)
+                        run.sResult += "wrong-length ";
+                    else if(run.dDiff > dTolerance)
+                        run.sResult += "output-drift ";
+                }
+            }
+            else {
+                if(uHash != run.uHash && run.sResult.find("not-repeatable") == std::string::npos)
+                    run.sResult += "not-repeatable ";
+            }
+        }
+    }
+
+    int iFailures = 0;
+    for(Run& run : runs) {
+        std::sort(run.costs.begin(), run.costs.end());
+        run.dCost = run.costs[run.costs.size() / 2];
+    }
+    printf("%-30s %10s %10s %8s %12s  %s\n", "signal/configuration", "ns/sample", "recorded", "change", "max diff", "result");
+    for(Run& run : runs) {
+        auto cost = recorded.find(run.sName);
+        char pcRecorded[32] = "-", pcChange[32] = "-", pcDiff[32] = "-";
+
+        if(bRecord) {
+            costFile << run.sName << " " << run.dCost << "\n";
+            referenceFile << run.sName << " " << run.summary.size();
+            char pcValue[32];
+            for(double dValue : run.summary) {
+                snprintf(pcValue, sizeof pcValue, " %.9g", dValue);
+                referenceFile << pcValue;
+            }
+            referenceFile << "\n";
+        }
+        else if(cost != recorded.end() && cost->second > 0) {
+            double dChange = 100.0 * (run.dCost / cost->second - 1);
+            snprintf(pcRecorded, sizeof pcRecorded, "%.2f", cost->second);
+            if(bTiming) {
+                snprintf(pcChange, sizeof pcChange, "%+.1f%%", dChange);
+                if(dChange > dSlowdown)
+                    run.sResult += "slower ";
+            }
+        }
+        if(run.dDiff >= 0)
+            snprintf(pcDiff, sizeof pcDiff, "%.3g", run.dDiff);
+
+        printf("%-30s %10.2f %10s %8s %12s  %s\n", run.sName.c_str(), run.dCost, pcRecorded, pcChange, pcDiff,
+               !run.sResult.empty() ? run.sResult.c_str() : bRecord ? "recorded" : "ok");
+        if(!run.sResult.empty())
+            iFailures++;
+    }
+    int iRuns = (int)runs.size();
+
+    std::string sMeters = checkMeters();
+    printf("%-30s %10s %10s %8s %12s  %s\n", "meters", "-", "-", "-", "-", sMeters.empty() ? "ok" : sMeters.c_str());
+    if(!sMeters.empty())
+        iFailures++;
+
+    if(bRecord)
+        printf("recorded %d configurations in %s and %s\n", iRuns, sReferences.c_str(), sDir.c_str());
+    else
+        printf("%d of %d configurations failed\n", iFailures, iRuns);
+    return iFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+//
+//  render.cpp
+//  Headless Render / Benchmark Harness
+//
+//  Drives createEffect() and MyEffect::process() outside the APDI host, over WAV files or
+//  synthetic signals, sweeping sample rates, block sizes and parameter sets. For each run it
+//  reports the average cost per sample, the worst block against its real-time deadline, and
+//  the real-time factor (seconds of audio processed per second of CPU). Any allocation made
+//  inside process() fails the run.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "apdi/Plugin.h"
+#include "apdi/Helpers.h"
+#if defined(MYEFFECT_PROFILE)
+#include "EffectPlugin.h"
+#endif
+#include "AllocationCounter.h"
+#include "ParameterSets.h"
+#include "Signals.h"
+#include "WavFile.h"
+
+extern "C" CREATE_FUNCTION createEffect(float sampleRate);
+
+struct RunResult
+{
+    double dNsPerSample;     // mean cost per sample frame
+    double dWorstBlockUs;    // slowest single process() call
+    double dDeadlineUs;      // length of one block in real time
+    double dRealTimeFactor;  // audio seconds / processing seconds
+    long iAllocations;       // allocations made inside process() (must be none)
+};
+
+static std::vector<std::string> splitList(const std::string& sList)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(sList);
+    std::string sItem;
+    while(std::getline(stream, sItem, ','))
+        if(!sItem.empty())
+            items.push_back(sItem);
+    return items;
+}
+
+// creates an instance the way the host would: set the rate, create, then push every control
+std::unique_ptr<APDI::Effect> createInstance(float fSampleRate, const ParameterSet& set)
+{
+    stk::Stk::setSampleRate(fSampleRate);
+    std::unique_ptr<APDI::Effect> effect(createEffect(fSampleRate));
+
+    for(int p = 0; p < effect->getNumParameters(); p++)
+        if(effect->getControl(p).type == APDI::Parameter::MENU)
+            effect->setParameter(p, effect->getParameter(p)); // host announces the initial menu items
+    for(const auto& value : set.values)
+        effect->setParameter(value.first, value.second);
+
+    return effect;
+}
+
+// processes the whole of 'input' in blocks of iBlockSize, timing every process() call
+RunResult run(APDI::Effect& effect, const AudioData& input, int iBlockSize, AudioData *pOutput)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    int iFrames = input.numFrames();
+    std::vector<float> inL(iBlockSize), inR(iBlockSize), outL(iBlockSize), outR(iBlockSize);
+    const float *ppIn[2] = { inL.data(), inR.data() };
+    float *ppOut[2] = { outL.data(), outR.data() };
+
+    const std::vector<float>& srcL = input.channels[0];
+    const std::vector<float>& srcR = input.channels[input.numChannels() > 1 ? 1 : 0];
+
+    if(pOutput) {
+        pOutput->fSampleRate = input.fSampleRate;
+        pOutput->channels.assign(2, std::vector<float>(iFrames));
+    }
+
+    Clock::duration total(0), worst(0);
+    AllocationCounter::clear();
+
+    for(int iPos = 0; iPos < iFrames; iPos += iBlockSize) {
+        int iCount = std::min(iBlockSize, iFrames - iPos);
+        std::copy(srcL.begin() + iPos, srcL.begin() + iPos + iCount, inL.begin());
+        std::copy(srcR.begin() + iPos, srcR.begin() + iPos + iCount, inR.begin());
+
+        Clock::time_point start = Clock::now();
+        {
+            AllocationCounter::Scope counting;
+            effect.process(ppIn, ppOut, iCount);
+        }
+        Clock::duration elapsed = Clock::now() - start;
+
+        total += elapsed;
+        if(iCount == iBlockSize && elapsed > worst)
+            worst = elapsed;
+
+        if(pOutput) {
+            std::copy(outL.begin(), outL.begin() + iCount, pOutput->channels[0].begin() + iPos);
+            std::copy(outR.begin(), outR.begin() + iCount, pOutput->channels[1].begin() + iPos);
+        }
+    }
+
+    double dTotalNs = std::chrono::duration<double, std::nano>(total).count();
+    RunResult result;
+    result.dNsPerSample = dTotalNs / std::max(iFrames, 1);
+    result.dWorstBlockUs = std::chrono::duration<double, std::micro>(worst).count();
+    result.dDeadlineUs = 1e6 * iBlockSize / input.fSampleRate;
+    result.dRealTimeFactor = (iFrames / input.fSampleRate) / (dTotalNs * 1e-9);
+    result.iAllocations = AllocationCounter::getCount();
+    return result;
+}
+
+#if defined(MYEFFECT_PROFILE)
+// where the time went inside process(), from the engine's stage counters
+static void printProfile(StageProfiler& profile)
+{
+    double dBlocks = std::max<double>(profile.getBlocks(), 1);
+    double dCyclesPerUs = StageProfiler::cyclesPerSecond() * 1e-6;
+    uint64_t uAll = std::max<uint64_t>(profile.getTotalCycles(StageProfiler::NUM_STAGES), 1);
+
+    printf("    %-10s %12s %8s %12s   %s\n", "stage", "mean (us)", "share", "worst (us)", "log2 cycles histogram, from 2^6");
+    for(int s = 0; s <= StageProfiler::NUM_STAGES; s++) {
+        printf("    %-10s %12.3f %7.1f%% %12.2f   ", StageProfiler::stageName(s),
+               profile.getTotalCycles(s) / dBlocks / dCyclesPerUs, 100.0 * profile.getTotalCycles(s) / uAll,
+               profile.getWorstCycles(s) / dCyclesPerUs);
+        for(int b = 6; b < 24; b++)
+            printf("%s%llu", b > 6 ? " " : "", (unsigned long long)profile.getHistogram(s, b));
+        printf("\n");
+    }
+    printf("    deadline misses %llu of %llu, worst block %.1f%% of its deadline\n",
+           (unsigned long long)profile.getDeadlineMisses(), (unsigned long long)profile.getBlocks(),
+           100.0 * profile.getWorstBlockLoad());
+}
+#endif
+
+static void usage()
+{
+    printf("usage: render [options]\n"
+           "  --in FILE.wav     process this file instead of a synthetic signal (its rate overrides --rates)\n"
+           "  --out FILE.wav    write the processed output of the first run as 32-bit float\n"
+           "  --signal NAME     synthetic signal: ");
+    for(const char* const* ppName = signalNames(); *ppName; ppName++)
+        printf("%s ", *ppName);
+    printf("(default bursts)\n"
+           "  --seconds S       length of the synthetic signal (default 10)\n"
+           "  --rates LIST      comma-separated sample rates (default 44100,48000,96000)\n"
+           "  --blocks LIST     comma-separated block sizes (default 32,64,128,256,512,1024)\n"
+           "  --params LIST     comma-separated parameter sets (default all):");
+    for(const ParameterSet& set : parameterSets())
+        printf(" %s", set.name.c_str());
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string sIn, sOut, sSignal = "bursts";
+    std::string sRates = "44100,48000,96000", sBlocks = "32,64,128,256,512,1024", sParams;
+    float fSeconds = 10;
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--in" && bHasValue) sIn = argv[++a];
+        else if(sArg == "--out" && bHasValue) sOut = argv[++a];
+        else if(sArg == "--signal" && bHasValue) sSignal = argv[++a];
+        else if(sArg == "--seconds" && bHasValue) fSeconds = (float)atof(argv[++a]);
+        else if(sArg == "--rates" && bHasValue) sRates = argv[++a];
+        else if(sArg == "--blocks" && bHasValue) sBlocks = argv[++a];
+        else if(sArg == "--params" && bHasValue) sParams = argv[++a];
+        else { usage(); return sArg == "--help" ? 0 : 1; }
+    }
+
+    AudioData file;
+    std::vector<float> rates;
+    if(!sIn.empty()) {
+        std::string sError;
+        if(!readWav(sIn, file, sError)) {
+            fprintf(stderr, "render: %s\n", sError.c_str());
+            return 1;
+        }
+        rates.push_back(file.fSampleRate);
+    }
+    else {
+        for(const std::string& sRate : splitList(sRates))
+            rates.push_back((float)atof(sRate.c_str()));
+    }
+
+    std::vector<int> blocks;
+    for(const std::string& sBlock : splitList(sBlocks))
+        blocks.push_back(std::max(1, atoi(sBlock.c_str())));
+
+    std::vector<const ParameterSet*> sets;
+    if(sParams.empty())
+        for(const ParameterSet& set : parameterSets())
+            sets.push_back(&set);
+    for(const std::string& sName : splitList(sParams)) {
+        const ParameterSet *pSet = findParameterSet(sName);
+        if(!pSet) {
+            fprintf(stderr, "render: unknown parameter set '%s'\n", sName.c_str());
+            return 1;
+        }
+        sets.push_back(pSet);
+    }
+
+    printf("%-8s %6s %-10s %10s %12s %12s %10s %10s\n",
+           "rate", "block", "params", "ns/sample", "worst (us)", "deadline", "worst %", "RT factor");
+
+    bool bWritten = false;
+    for(float fRate : rates) {
+        AudioData input;
+        if(!sIn.empty())
+            input = file;
+        else if(!makeSignal(sSignal, fRate, fSeconds, input)) {
+            fprintf(stderr, "render: unknown signal '%s'\n", sSignal.c_str());
+            return 1;
+        }
+
+        for(int iBlock : blocks) {
+            for(const ParameterSet *pSet : sets) {
+                std::unique_ptr<APDI::Effect> effect = createInstance(fRate, *pSet);
+
+                AudioData output;
+                bool bWrite = !sOut.empty() && !bWritten;
+                RunResult result = run(*effect, input, iBlock, bWrite ? &output : nullptr);
+
+                printf("%-8.0f %6d %-10s %10.2f %12.2f %12.2f %9.2f%% %10.1f\n",
+                       fRate, iBlock, pSet->name.c_str(), result.dNsPerSample, result.dWorstBlockUs,
+                       result.dDeadlineUs, 100.0 * result.dWorstBlockUs / result.dDeadlineUs,
+                       result.dRealTimeFactor);
+#if defined(MYEFFECT_PROFILE)
+                printProfile(static_cast<MyEffect&>(*effect).getProfile());
+#endif
+                if(result.iAllocations > 0) {
+                    fprintf(stderr, "render: %ld allocations inside process()\n", result.iAllocations);
+                    return 1;
+                }
+
+                if(bWrite) {
+                    if(!writeWav(sOut, output)) {
+                        fprintf(stderr, "render: cannot write %s\n", sOut.c_str());
+                        return 1;
+                    }
+                    bWritten = true;
+                }
+            }
+        }
+    }
+    return 0;
+}
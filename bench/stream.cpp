@@ -0,0 +1,121 @@
+//
+//  stream.cpp
+//  Offline Streaming Processor
+//
+//  Runs MyEffect over a WAV or RF64 file of any length (hours of podcast or meeting audio),
+//  streaming it through memory maps in fixed-size blocks: one instance processes the whole
+//  file, so its state carries across every block, and the file is never held in memory. The
+//  output is 32-bit float stereo, RF64 if it passes 4 GB. Reports the throughput at the end.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apdi/Plugin.h"
+#include "apdi/Helpers.h"
+#include "MappedWav.h"
+#include "ParameterSets.h"
+
+extern "C" CREATE_FUNCTION createEffect(float sampleRate);
+
+static const uint64_t kReleaseBytes = 16 << 20; // pages are handed back to the kernel every 16 MB of input
+
+static void usage()
+{
+    printf("usage: stream --in FILE.wav --out FILE.wav [--params NAME] [--block N]\n"
+           "  --params NAME     parameter set (default full):");
+    for(const ParameterSet& set : parameterSets())
+        printf(" %s", set.name.c_str());
+    printf("\n"
+           "  --block N         frames per process() call (default 1024)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string sIn, sOut, sParams = "full";
+    int iBlockSize = 1024;
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--in" && bHasValue) sIn = argv[++a];
+        else if(sArg == "--out" && bHasValue) sOut = argv[++a];
+        else if(sArg == "--params" && bHasValue) sParams = argv[++a];
+        else if(sArg == "--block" && bHasValue) iBlockSize = std::max(1, atoi(argv[++a]));
+        else { usage(); return sArg == "--help" ? 0 : 1; }
+    }
+    if(sIn.empty() || sOut.empty()) {
+        usage();
+        return 1;
+    }
+    const ParameterSet *pSet = findParameterSet(sParams);
+    if(!pSet) {
+        fprintf(stderr, "stream: unknown parameter set '%s'\n", sParams.c_str());
+        return 1;
+    }
+
+    std::string sError;
+    MappedWavReader reader;
+    if(!reader.open(sIn, sError)) {
+        fprintf(stderr, "stream: %s\n", sError.c_str());
+        return 1;
+    }
+    const WavLayout& layout = reader.getLayout();
+
+    MappedWavWriter writer;
+    if(!writer.open(sOut, 2, layout.fSampleRate, layout.uFrames, sError)) {
+        fprintf(stderr, "stream: %s\n", sError.c_str());
+        return 1;
+    }
+
+    stk::Stk::setSampleRate(layout.fSampleRate);
+    std::unique_ptr<APDI::Effect> effect(createEffect(layout.fSampleRate));
+    for(int p = 0; p < effect->getNumParameters(); p++)
+        if(effect->getControl(p).type == APDI::Parameter::MENU)
+            effect->setParameter(p, effect->getParameter(p)); // host announces the initial menu items
+    for(const auto& value : pSet->values)
+        effect->setParameter(value.first, value.second);
+
+    // one buffer per input channel, a mono file feeds both plugin inputs
+    std::vector<std::vector<float>> input(layout.iChannels, std::vector<float>(iBlockSize));
+    std::vector<float> outL(iBlockSize), outR(iBlockSize);
+    std::vector<float*> ppDecoded(layout.iChannels);
+    for(int c = 0; c < layout.iChannels; c++)
+        ppDecoded[c] = input[c].data();
+    const float *ppIn[2] = { input[0].data(), input[layout.iChannels > 1 ? 1 : 0].data() };
+    float *ppOut[2] = { outL.data(), outR.data() };
+
+    uint64_t uReleaseFrames = std::max<uint64_t>(kReleaseBytes / layout.frameBytes(), iBlockSize), uNextRelease = uReleaseFrames;
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    for(uint64_t uPos = 0; uPos < layout.uFrames; uPos += iBlockSize) {
+        int iCount = (int)std::min<uint64_t>(iBlockSize, layout.uFrames - uPos);
+        reader.read(uPos, iCount, ppDecoded.data());
+        effect->process(ppIn, ppOut, iCount);
+        writer.write(uPos, iCount, ppOut);
+
+        if(uPos + iCount >= uNextRelease) {
+            reader.release(uPos + iCount);
+            writer.release(uPos + iCount);
+            uNextRelease += uReleaseFrames;
+        }
+    }
+    if(!writer.close(sError)) {
+        fprintf(stderr, "stream: %s: %s\n", sOut.c_str(), sError.c_str());
+        return 1;
+    }
+
+    double dSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double dAudio = layout.uFrames / layout.fSampleRate;
+    printf("%s: %llu frames, %d ch, %d-bit %s, %.0f Hz (%.1f min)\n", sIn.c_str(), (unsigned long long)layout.uFrames,
+           layout.iChannels, layout.iBits, layout.bFloat ? "float" : "PCM", layout.fSampleRate, dAudio / 60);
+    printf("processed in %.2f s: %.1f MB/s in, %.1f MB/s out, %.0fx real time\n", dSeconds,
+           layout.uFrames * layout.frameBytes() / dSeconds * 1e-6, layout.uFrames * 8 / dSeconds * 1e-6, dAudio / dSeconds);
+    return 0;
+}
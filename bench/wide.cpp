@@ -0,0 +1,146 @@
+//
+//  wide.cpp
+//  Multichannel Gate Engine Benchmark
+//
+//  Times one GateEngine<N> against the stereo instances it replaces, for the bus widths the
+//  engine is built for (1, 2, 6, 8 and 16 channels), linked and unlinked. Also checks that an
+//  unlinked N-channel engine gives every channel exactly what a mono engine gives it.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GateEngine.h"
+#include "Signals.h"
+
+typedef std::vector<std::vector<float>> Bus;
+
+// gate and delay both working, as the "full" parameter set
+static GateEngineBase::Settings benchSettings(GateEngineBase::Link link)
+{
+    GateEngineBase::Settings settings;
+    settings.fThreshDb = -40; settings.fHystDb = -6; settings.fReductionDb = -60;
+    settings.fAttack = 5; settings.fHold = 50; settings.fRelease = 50;
+    settings.filterType = SidechainFilter::BANDPASS;
+    settings.fLowPass = 200; settings.fHighPass = 1000; settings.fCentre = 1000; settings.fWidth = 800;
+    settings.fDetector = 1; settings.fLookahead = 0;
+    settings.fFeedback = 0.5f; settings.fDelayTime = 250;
+    settings.fWetPercent = 100; settings.fDryPercent = 100;
+    settings.link = link;
+    settings.bands = GateEngineBase::BROADBAND;
+    return settings;
+}
+
+// noise bursts like the "bursts" signal, each channel starting its bursts a little later
+static Bus makeBus(int iChannels, float fSampleRate, float fSeconds)
+{
+    int iFrames = (int)(fSampleRate * fSeconds);
+    Bus bus(iChannels, std::vector<float>(iFrames));
+    NoiseSource noise(12345);
+    for(int f = 0; f < iFrames; f++)
+        for(int c = 0; c < iChannels; c++) {
+            bool bOn = fmodf(f / fSampleRate + 0.03f * c, 0.5f) < 0.2f;
+            bus[c][f] = noise.next() * (bOn ? 0.25f : 0.001f);
+        }
+    return bus;
+}
+
+// runs iChannels of the bus, starting at iFirst, through one engine; returns the seconds spent in process()
+template <int Channels>
+double runEngine(const Bus& in, Bus& out, int iFirst, float fSampleRate, int iBlockSize, const GateEngineBase::Settings& settings)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::unique_ptr<GateEngine<Channels>> engine(new GateEngine<Channels>);
+    engine->prepare(fSampleRate);
+    engine->setSettings(settings);
+
+    int iFrames = (int)in[0].size();
+    const float *ppIn[Channels];
+    float *ppOut[Channels];
+    Clock::duration total(0);
+
+    for(int iPos = 0; iPos < iFrames; iPos += iBlockSize) {
+        int iCount = std::min(iBlockSize, iFrames - iPos);
+        for(int c = 0; c < Channels; c++) {
+            ppIn[c] = in[iFirst + c].data() + iPos;
+            ppOut[c] = out[iFirst + c].data() + iPos;
+        }
+        Clock::time_point start = Clock::now();
+        engine->process(ppIn, ppOut, iCount, fSampleRate);
+        total += Clock::now() - start;
+    }
+    return std::chrono::duration<double>(total).count();
+}
+
+// one wide engine against the stereo (and, for odd widths, mono) engines covering the same bus
+template <int Channels>
+bool compare(float fSampleRate, int iBlockSize, float fSeconds)
+{
+    Bus in = makeBus(Channels, fSampleRate, fSeconds);
+    Bus wide(in), narrow(in), mono(in);
+    double dFrames = in[0].size();
+    bool bOk = true;
+
+    for(int l = 0; l < 2; l++) {
+        GateEngineBase::Link link = (GateEngineBase::Link)l;
+        GateEngineBase::Settings settings = benchSettings(link);
+
+        double dWide = runEngine<Channels>(in, wide, 0, fSampleRate, iBlockSize, settings);
+        double dNarrow = 0;
+        int c = 0;
+        for(; c + 2 <= Channels; c += 2)
+            dNarrow += runEngine<2>(in, narrow, c, fSampleRate, iBlockSize, settings);
+        if(c < Channels)
+            dNarrow += runEngine<1>(in, narrow, c, fSampleRate, iBlockSize, settings);
+
+        // unlinked, every channel is independent: must match a mono engine exactly
+        float fWorst = 0;
+        if(link == GateEngineBase::UNLINKED) {
+            for(c = 0; c < Channels; c++)
+                runEngine<1>(in, mono, c, fSampleRate, iBlockSize, settings);
+            for(c = 0; c < Channels; c++)
+                for(size_t f = 0; f < in[c].size(); f++)
+                    fWorst = std::max(fWorst, fabsf(wide[c][f] - mono[c][f]));
+            bOk = bOk && fWorst == 0;
+        }
+
+        double dWideNs = 1e9 * dWide / (dFrames * Channels), dNarrowNs = 1e9 * dNarrow / (dFrames * Channels);
+        printf("%8d %-9s %14.2f %14.2f %8.2fx   %s\n", Channels, l == 0 ? "linked" : "unlinked",
+               dWideNs, dNarrowNs, dNarrowNs / dWideNs,
+               link == GateEngineBase::LINKED ? "-" : (fWorst == 0 ? "exact" : "MISMATCH"));
+    }
+    return bOk;
+}
+
+int main(int argc, char *argv[])
+{
+    float fSampleRate = 48000, fSeconds = 5;
+    int iBlockSize = 64;
+
+    for(int a = 1; a < argc; a++) {
+        std::string sArg = argv[a];
+        bool bHasValue = a + 1 < argc;
+        if(sArg == "--rate" && bHasValue) fSampleRate = (float)atof(argv[++a]);
+        else if(sArg == "--block" && bHasValue) iBlockSize = atoi(argv[++a]);
+        else if(sArg == "--seconds" && bHasValue) fSeconds = (float)atof(argv[++a]);
+        else {
+            printf("usage: wide [--rate HZ] [--block N] [--seconds S]\n");
+            return sArg == "--help" ? 0 : 1;
+        }
+    }
+
+    printf("%d Hz, %d-sample blocks, ns per channel-sample\n", (int)fSampleRate, iBlockSize);
+    printf("channels link      one engine   stereo engines  speedup   unlinked vs mono\n");
+    bool bOk = compare<1>(fSampleRate, iBlockSize, fSeconds);
+    bOk = compare<2>(fSampleRate, iBlockSize, fSeconds) && bOk;
+    bOk = compare<6>(fSampleRate, iBlockSize, fSeconds) && bOk;
+    bOk = compare<8>(fSampleRate, iBlockSize, fSeconds) && bOk;
+    bOk = compare<16>(fSampleRate, iBlockSize, fSeconds) && bOk;
+    return bOk ? 0 : 1;
+}